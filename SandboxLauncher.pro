@@ -39,9 +39,37 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += \
     main.cpp \
-    console.cpp
+    console.cpp \
+    boxlock.cpp \
+    storage.cpp \
+    steamlibrary.cpp \
+    sandboxieini.cpp \
+    trace.cpp \
+    stats.cpp \
+    utf.cpp \
+    prefetch.cpp \
+    supervise.cpp \
+    agent.cpp \
+    controller.cpp \
+    journal.cpp \
+    capture.cpp \
+    failure.cpp
 
-win32: LIBS += -luser32 -lshell32 -lkernel32 -ladvapi32
+win32: LIBS += -luser32 -lshell32 -lkernel32 -ladvapi32 -lws2_32
 
 HEADERS += \
-    console.h
+    console.h \
+    boxlock.h \
+    storage.h \
+    steamlibrary.h \
+    sandboxieini.h \
+    trace.h \
+    stats.h \
+    utf.h \
+    prefetch.h \
+    supervise.h \
+    agent.h \
+    controller.h \
+    journal.h \
+    capture.h \
+    failure.h
@@ -0,0 +1,40 @@
+#**************************************************************************
+#    SandboxLauncher_startup.pro
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+#
+#    File SandboxLauncher_startup.pro created by afischer on 18.10.2026
+#**************************************************************************
+
+# Same program as SandboxLauncher.pro, built for the shortest possible start.
+# The launcher only lives for a moment per launch, so loading and initializing
+# the binary is a good part of it. Measure with bench/startup_bench.pro.
+
+include(SandboxLauncher.pro)
+
+DEFINES += NDEBUG
+
+# Whole program optimization and size over speed, fewer pages to fault in
+CONFIG += ltcg
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += /O1 /Gy /Gw
+QMAKE_LFLAGS_RELEASE += /OPT:REF /OPT:ICF /INCREMENTAL:NO
+
+# user32 is only needed for message boxes, shell32/advapi32 hardly ever and
+# ws2_32 only for /agent and /controller, so they are not loaded (and
+# initialized) on a normal launch
+win32: QMAKE_LFLAGS_RELEASE += /DELAYLOAD:user32.dll /DELAYLOAD:shell32.dll /DELAYLOAD:advapi32.dll /DELAYLOAD:ws2_32.dll
+win32: LIBS += -ldelayimp
@@ -0,0 +1,476 @@
+/**************************************************************************
+    agent.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File agent.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <Windows.h>
+#include <shellapi.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <wctype.h>
+
+#include "agent.h"
+#include "console.h"
+#include "sandboxieini.h"
+#include "utf.h"
+
+using namespace std;
+
+#define MAX_LINE 65536
+
+static wstring _agentToken;
+static vector<wstring> _agentLocalArgs;
+static unsigned int _agentCapacity = AGENT_DEFAULT_CAPACITY;
+static volatile LONG _agentRunning = 0;
+static CRITICAL_SECTION _agentOutput;
+
+/* The only arguments a remote launch may use. Anything naming a path or file stays with the agent */
+static const wchar_t *remoteAllowed[] = {
+                                    TEXT("box"),
+                                    TEXT("id"),
+                                    TEXT("user"),
+                                    TEXT("pass"),
+                                    TEXT("terminate"),
+                                    TEXT("clear"),
+                                    TEXT("noexec"),
+                                    TEXT("prefetch"),
+                                    TEXT("locktimeout")
+                                  };
+
+static bool readLine(SOCKET sock, string &line)
+{
+    line.clear();
+    char c;
+    while (line.length()<MAX_LINE)
+    {
+        if (recv(sock, &c, 1, 0)!=1)
+            return false;
+        if (c=='\n')
+        {
+            if (!line.empty() && line.back()=='\r')
+                line.pop_back();
+            return true;
+        }
+        line.push_back(c);
+    }
+    return false;
+}
+
+static bool writeLine(SOCKET sock, const wstring &text)
+{
+    string line = wideToUtf8(text);
+    line.append("\r\n");
+
+    size_t sent = 0;
+    while (sent<line.length())
+    {
+        int result = send(sock, line.data() + sent, static_cast<int>(line.length() - sent), 0);
+        if (result<=0)
+            return false;
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+static void agentLog(const wstring &text)
+{
+    EnterCriticalSection(&_agentOutput);
+    consoleWrite(text + TEXT("\n"));
+    LeaveCriticalSection(&_agentOutput);
+}
+
+/* Quotes one argument for the child command line, trailing backslashes must not escape the closing quote */
+static wstring quoteArg(const wstring &arg)
+{
+    size_t last = arg.find_last_not_of('\\');
+    size_t backslashes = last==wstring::npos ? arg.length() : arg.length() - last - 1;
+
+    wstring quoted(TEXT("\""));
+    quoted.append(arg);
+    quoted.append(backslashes, '\\');
+    quoted.append(TEXT("\""));
+    return quoted;
+}
+
+/*
+ * Checks the remote arguments, every one has to look like /name or /name:value
+ * with a name from remoteAllowed and no quotes. /box has to be a valid box
+ * name, /id and /user a single word. They are put together again
+ * one quoted argument each, so the child sees exactly what we checked.
+ */
+static bool remoteArgs(const wstring &args, wstring &checked)
+{
+    checked.clear();
+
+    int argc = 0;
+    LPWSTR *argv = CommandLineToArgvW(args.data(), &argc);
+    if (!argv)
+        return false;
+
+    bool valid = argc>0;
+    for (int idx = 0; idx<argc && valid; idx++)
+    {
+        wstring arg(argv[idx]);
+        if (arg.length()<2 || arg.at(0)!='/' || arg.find('"')!=wstring::npos)
+        {
+            valid = false;
+            break;
+        }
+
+        wstring name = arg.substr(1, arg.find(':') - 1);
+        transform(name.begin(), name.end(), name.begin(), ::towlower);
+        valid = any_of(begin(remoteAllowed), end(remoteAllowed), [&name](const wchar_t *allowed) { return name==allowed; });
+
+        /* the values that end up in paths and Steam's command line, nothing that could leave them */
+        size_t colon = arg.find(':');
+        wstring value = colon==wstring::npos ? wstring() : arg.substr(colon + 1);
+        if (name==TEXT("box"))
+            valid = valid && iniValidBoxName(value);
+        else if (name==TEXT("id") || name==TEXT("user"))
+            valid = valid && !value.empty() && value.find_first_of(TEXT(" \t\\/"))==wstring::npos;
+
+        if (!checked.empty())
+            checked.append(TEXT(" "));
+        checked.append(quoteArg(arg));
+    }
+
+    LocalFree(argv);
+    return valid;
+}
+
+/* Compares the whole token every time, so the answer time tells nothing about how much was right */
+static bool tokenMatches(const wstring &token)
+{
+    wchar_t diff = static_cast<wchar_t>(token.length()!=_agentToken.length());
+    for (size_t idx = 0; idx<_agentToken.length(); idx++)
+        diff |= _agentToken.at(idx) ^ (idx<token.length() ? token.at(idx) : 0);
+    return diff==0;
+}
+
+/*
+ * Runs this exe again with the checked args and the agent's own paths and
+ * waits for it, the reply is the answer line for the controller. The child
+ * gets /noretry, retrying is up to the controller, and /nodialogs, nobody
+ * would see a dialog here. One that takes too long is ended.
+ */
+static wstring runChild(const wstring &args)
+{
+    if (static_cast<unsigned int>(InterlockedIncrement(&_agentRunning))>_agentCapacity)
+    {
+        InterlockedDecrement(&_agentRunning);
+        return TEXT("BUSY");
+    }
+
+    wchar_t exeName[MAX_PATH];
+    GetModuleFileNameW(nullptr, exeName, MAX_PATH);
+
+    wstring commandLine(TEXT("\""));
+    commandLine.append(exeName);
+    commandLine.append(TEXT("\" "));
+    commandLine.append(args);
+    commandLine.append(TEXT(" /noretry /nodialogs"));
+    for (const wstring &arg : _agentLocalArgs)
+    {
+        commandLine.append(TEXT(" "));
+        commandLine.append(quoteArg(arg));
+    }
+
+    STARTUPINFOW si;
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    ZeroMemory(&pi, sizeof(pi));
+
+    wstring reply;
+    if (CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi))
+    {
+        DWORD exitCode = 0;
+        if (WaitForSingleObject(pi.hProcess, AGENT_CHILD_TIMEOUT)==WAIT_OBJECT_0)
+        {
+            GetExitCodeProcess(pi.hProcess, &exitCode);
+            reply = TEXT("OK ") + to_wstring(exitCode);
+        } else {
+            TerminateProcess(pi.hProcess, ERROR_TIMEOUT);
+            reply = TEXT("ERR ") + to_wstring(ERROR_TIMEOUT);
+        }
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+    } else {
+        reply = TEXT("ERR ") + to_wstring(GetLastError());
+    }
+
+    InterlockedDecrement(&_agentRunning);
+    return reply;
+}
+
+static wstring handleRequest(const wstring &request)
+{
+    size_t space = request.find(' ');
+    wstring token = request.substr(0, space);
+    wstring rest = space==wstring::npos ? wstring() : request.substr(space + 1);
+
+    if (!_agentToken.empty() && !tokenMatches(token))
+        return TEXT("ERR ") + to_wstring(ERROR_ACCESS_DENIED);
+
+    space = rest.find(' ');
+    wstring verb = rest.substr(0, space);
+    wstring args = space==wstring::npos ? wstring() : rest.substr(space + 1);
+
+    if (verb==TEXT("STATUS"))
+        return TEXT("OK ") + to_wstring(max(0L, static_cast<long>(_agentRunning))) + TEXT(" ") + to_wstring(_agentCapacity);
+
+    if ((verb==TEXT("TERMINATE") || verb==TEXT("CLEAR")) && !args.empty() && args.find('"')==wstring::npos)
+        args = TEXT("\"/box:") + args + (verb==TEXT("CLEAR") ? TEXT("\" /clear /noexec") : TEXT("\" /terminate /noexec"));
+    else if (verb!=TEXT("LAUNCH"))
+        return TEXT("ERR ") + to_wstring(ERROR_INVALID_PARAMETER);
+
+    wstring checked;
+    if (!remoteArgs(args, checked))
+        return TEXT("ERR ") + to_wstring(ERROR_INVALID_PARAMETER);
+
+    return runChild(checked);
+}
+
+static DWORD WINAPI agentConnection(LPVOID param)
+{
+    SOCKET sock = static_cast<SOCKET>(reinterpret_cast<ULONG_PTR>(param));
+
+    string line;
+    if (readLine(sock, line))
+    {
+        wstring request = utf8ToWide(line);
+        size_t space = request.find(' ');
+        agentLog(TEXT("> ") + (space==wstring::npos ? request : request.substr(space + 1)));
+
+        wstring reply = handleRequest(request);
+        agentLog(TEXT("< ") + reply);
+        writeLine(sock, reply);
+    }
+
+    shutdown(sock, SD_BOTH);
+    closesocket(sock);
+    return 0;
+}
+
+/* Opens one listening socket, INVALID_SOCKET and errorCode if that does not work */
+static SOCKET agentListen(const sockaddr *address, int length, bool dualStack, DWORD &errorCode)
+{
+    SOCKET listener = socket(address->sa_family, SOCK_STREAM, IPPROTO_TCP);
+    if (listener==INVALID_SOCKET)
+    {
+        errorCode = static_cast<DWORD>(WSAGetLastError());
+        return INVALID_SOCKET;
+    }
+
+    if (dualStack)
+    {
+        DWORD v6Only = 0;
+        setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char *>(&v6Only), sizeof(v6Only));
+    }
+
+    if (::bind(listener, address, length)==SOCKET_ERROR || listen(listener, SOMAXCONN)==SOCKET_ERROR)
+    {
+        errorCode = static_cast<DWORD>(WSAGetLastError());
+        closesocket(listener);
+        return INVALID_SOCKET;
+    }
+    return listener;
+}
+
+/*
+ * Serves requests until the process is ended, every connection gets its own
+ * thread. localArgs (/name:value) are added to every launch. Without a token
+ * we take connections from this machine only.
+ */
+void agentRun(unsigned short port, const wstring &token, unsigned int capacity, const vector<wstring> &localArgs,
+              bool &ok, DWORD &errorCode)
+{
+    ok = false;
+    _agentToken = token==TEXT("-") ? wstring() : token;
+    _agentLocalArgs = localArgs;
+    _agentCapacity = max(1u, capacity);
+    InitializeCriticalSection(&_agentOutput);
+
+    WSADATA wsaData;
+    errorCode = static_cast<DWORD>(WSAStartup(MAKEWORD(2, 2), &wsaData));
+    if (errorCode!=0)
+        return;
+
+    sockaddr_in6 address6;
+    ZeroMemory(&address6, sizeof(address6));
+    address6.sin6_family = AF_INET6;
+    address6.sin6_port = htons(port);
+
+    /*
+     * With a token one dual stack socket takes everyone. A v6 socket on ::1 does
+     * not take IPv4 though, so without one it is a socket on 127.0.0.1 and, if
+     * this machine has IPv6 at all, another one on ::1.
+     */
+    vector<SOCKET> listeners;
+    SOCKET listener;
+    if (_agentToken.empty())
+    {
+        sockaddr_in address4;
+        ZeroMemory(&address4, sizeof(address4));
+        address4.sin_family = AF_INET;
+        address4.sin_port = htons(port);
+        address4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listener = agentListen(reinterpret_cast<sockaddr *>(&address4), sizeof(address4), false, errorCode);
+        if (listener!=INVALID_SOCKET)
+        {
+            listeners.push_back(listener);
+
+            DWORD v6Error;
+            address6.sin6_addr = in6addr_loopback;
+            listener = agentListen(reinterpret_cast<sockaddr *>(&address6), sizeof(address6), false, v6Error);
+            if (listener!=INVALID_SOCKET)
+                listeners.push_back(listener);
+        }
+    } else {
+        address6.sin6_addr = in6addr_any;
+        listener = agentListen(reinterpret_cast<sockaddr *>(&address6), sizeof(address6), true, errorCode);
+        if (listener!=INVALID_SOCKET)
+            listeners.push_back(listener);
+    }
+
+    if (listeners.empty())
+    {
+        WSACleanup();
+        return;
+    }
+
+    agentLog(TEXT("Agent listening on port ") + to_wstring(port) + TEXT(", capacity ") + to_wstring(_agentCapacity));
+    if (_agentToken.empty())
+        agentLog(TEXT("No /token given, only accepting connections from this machine"));
+
+    bool serving = true;
+    while (serving)
+    {
+        fd_set ready;
+        FD_ZERO(&ready);
+        for (SOCKET waiting : listeners)
+            FD_SET(waiting, &ready);
+
+        if (select(0, &ready, nullptr, nullptr, nullptr)==SOCKET_ERROR)
+        {
+            errorCode = static_cast<DWORD>(WSAGetLastError());
+            break;
+        }
+
+        for (SOCKET waiting : listeners)
+        {
+            if (!FD_ISSET(waiting, &ready))
+                continue;
+
+            SOCKET sock = accept(waiting, nullptr, nullptr);
+            if (sock==INVALID_SOCKET)
+            {
+                errorCode = static_cast<DWORD>(WSAGetLastError());
+                serving = false;
+                break;
+            }
+
+            HANDLE thread = CreateThread(nullptr, 0, agentConnection, reinterpret_cast<LPVOID>(static_cast<ULONG_PTR>(sock)), 0, nullptr);
+            if (thread)
+                CloseHandle(thread);
+            else
+                closesocket(sock);
+        }
+    }
+
+    for (SOCKET waiting : listeners)
+        closesocket(waiting);
+    WSACleanup();
+}
+
+/*
+ * Sends one request to the agent at host:port and reads the answer line. The
+ * caller has to have Winsock started.
+ */
+void agentRequest(const wstring &address, const wstring &token, const wstring &request, wstring &reply, bool &ok, DWORD &errorCode)
+{
+    ok = false;
+    errorCode = 0;
+    reply.clear();
+
+    /* host, host:port, [v6 address] or [v6 address]:port */
+    wstring host(address);
+    wstring port = to_wstring(AGENT_DEFAULT_PORT);
+    size_t colon = address.find_last_of(':');
+    if (!address.empty() && address.front()=='[')
+    {
+        size_t close = address.find(']');
+        host = address.substr(1, close==wstring::npos ? wstring::npos : close - 1);
+        if (close!=wstring::npos && colon==close + 1)
+            port = address.substr(colon + 1);
+    } else if (colon!=wstring::npos && colon==address.find(':')) {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+
+    ADDRINFOW hints;
+    ZeroMemory(&hints, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    ADDRINFOW *result = nullptr;
+    int error = GetAddrInfoW(host.data(), port.data(), &hints, &result);
+    if (error!=0)
+    {
+        errorCode = static_cast<DWORD>(error);
+        return;
+    }
+
+    SOCKET sock = INVALID_SOCKET;
+    for (ADDRINFOW *info = result; info && sock==INVALID_SOCKET; info = info->ai_next)
+    {
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (sock==INVALID_SOCKET)
+            continue;
+        if (connect(sock, info->ai_addr, static_cast<int>(info->ai_addrlen))==SOCKET_ERROR)
+        {
+            errorCode = static_cast<DWORD>(WSAGetLastError());
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+    FreeAddrInfoW(result);
+
+    if (sock==INVALID_SOCKET)
+        return;
+
+    DWORD timeout = AGENT_REPLY_TIMEOUT;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+
+    string line;
+    if (writeLine(sock, (token.empty() ? wstring(TEXT("-")) : token) + TEXT(" ") + request) && readLine(sock, line))
+    {
+        reply = utf8ToWide(line);
+        ok = true;
+    } else {
+        errorCode = static_cast<DWORD>(WSAGetLastError());
+    }
+
+    closesocket(sock);
+}
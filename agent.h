@@ -0,0 +1,60 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+/**************************************************************************
+    agent.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File agent.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Lets a controller on another machine start launches here. The agent listens
+ * on a TCP port and takes one request line per connection, answers with one
+ * line and closes. All lines are UTF-8:
+ *
+ *   <token> STATUS             OK <running> <capacity>
+ *   <token> LAUNCH <args>      OK <exit code> | BUSY | ERR <windows error>
+ *   <token> TERMINATE <box>    same as LAUNCH
+ *   <token> CLEAR <box>        same as LAUNCH
+ *
+ * The token is "-" if none is set. Without a token the agent only listens on
+ * the IPv4 and IPv6 loopback addresses. Every launch runs as a child instance of this exe, at
+ * most capacity of them at once. A request may only use the launch arguments
+ * of remoteAllowed, paths like /sandboxie, /steam and /ini come from the
+ * agent's own command line. There is no encryption, token and /pass go over
+ * the wire as they are, so this is meant for a trusted local network only.
+ */
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define AGENT_DEFAULT_PORT 27900
+#define AGENT_DEFAULT_CAPACITY 4
+/* A launch with /clear can take a while, the controller waits this long for the answer */
+#define AGENT_REPLY_TIMEOUT 900000
+/* The agent ends a launch running longer, so the answer still makes it in time */
+#define AGENT_CHILD_TIMEOUT 840000
+
+void agentRun(unsigned short port, const wstring &token, unsigned int capacity, const vector<wstring> &localArgs,
+              bool &ok, DWORD &errorCode);
+void agentRequest(const wstring &address, const wstring &token, const wstring &request, wstring &reply, bool &ok, DWORD &errorCode);
+
+#endif // AGENT_H
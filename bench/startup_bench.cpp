@@ -0,0 +1,254 @@
+/**************************************************************************
+    startup_bench.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File startup_bench.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Startup benchmark for SandboxLauncher.exe
+ *
+ * Measures the time from starting the launcher until it starts its first
+ * process, over and over. Sandboxie and Steam are not needed: we copy
+ * ourself as Start.exe and Steam.exe into a temp folder and point the
+ * launcher there. When started under one of those names we only signal
+ * the benchmark and quit.
+ *
+ * Every run is: SandboxLauncher.exe /box:Bench /terminate /noexec
+ * with its own Sandboxie.ini and LOCALAPPDATA in the temp folder, so the
+ * launcher does all its usual work without touching the real ones.
+ *
+ * The fake Start.exe needs some time to start itself, that part is measured
+ * separately (baseline) and taken off.
+ *
+ * Usage:
+ * startup_bench.exe path\to\SandboxLauncher.exe [runs]
+ */
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <wctype.h>
+
+using namespace std;
+
+static const wchar_t eventVariable[] = TEXT("SANDBOXLAUNCHER_BENCH_EVENT");
+static const int warmupRuns = 5;
+
+static double now()
+{
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart==0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<double>(counter.QuadPart) * 1000.0 / static_cast<double>(frequency.QuadPart);
+}
+
+/* We are the fake Start.exe or Steam.exe... tell the benchmark and go */
+static int fakeChild()
+{
+    wchar_t name[128];
+    DWORD length = GetEnvironmentVariableW(eventVariable, name, 128);
+    if (length==0 || length>=128)
+        return 0;
+
+    HANDLE event = OpenEventW(EVENT_MODIFY_STATE, FALSE, name);
+    if (event)
+    {
+        SetEvent(event);
+        CloseHandle(event);
+    }
+    return 0;
+}
+
+/*
+ * Starts the command line and returns the ms until the event got signaled,
+ * total is the ms until the process was gone. -1 if it never signaled.
+ */
+static double timeRun(const wstring &command, HANDLE event, HANDLE nul, double &total)
+{
+    STARTUPINFOW si;
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = nul;
+    si.hStdOutput = nul;
+    si.hStdError = nul;
+    ZeroMemory(&pi, sizeof(pi));
+
+    wstring cmd(command);
+    ResetEvent(event);
+
+    double started = now();
+    if (!CreateProcessW(nullptr, &cmd[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &si, &pi))
+        return -1;
+
+    double signaled = -1;
+    HANDLE handles[2] = { event, pi.hProcess };
+    DWORD result = WaitForMultipleObjects(2, handles, FALSE, 30000);
+    if (result==WAIT_OBJECT_0)
+        signaled = now() - started;
+
+    WaitForSingleObject(pi.hProcess, 30000);
+    total = now() - started;
+
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return signaled;
+}
+
+static void printTimes(const wchar_t *title, vector<double> times)
+{
+    if (times.empty())
+    {
+        wcout << left << setw(24) << title << "no successful runs" << endl;
+        return;
+    }
+
+    sort(times.begin(), times.end());
+    double sum = 0;
+    for (double time : times)
+        sum += time;
+
+    size_t count = times.size();
+    wcout << left << setw(24) << title << right << fixed << setprecision(2)
+          << setw(10) << times.front()
+          << setw(10) << times.at(count / 2)
+          << setw(10) << times.at(count * 9 / 10)
+          << setw(10) << times.at(min(count - 1, count * 99 / 100))
+          << setw(10) << times.back()
+          << setw(10) << sum / count << endl;
+}
+
+int wmain(int argc, wchar_t **argv)
+{
+    wchar_t selfBuffer[MAX_PATH];
+    GetModuleFileNameW(nullptr, selfBuffer, MAX_PATH);
+    wstring self(selfBuffer);
+
+    wstring selfName = self.substr(self.find_last_of('\\') + 1);
+    transform(selfName.begin(), selfName.end(), selfName.begin(), ::towlower);
+    if (selfName==TEXT("start.exe") || selfName==TEXT("steam.exe"))
+        return fakeChild();
+
+    if (argc<2)
+    {
+        wcout << "Usage: startup_bench.exe path\\to\\SandboxLauncher.exe [runs]" << endl;
+        return 1;
+    }
+
+    wstring launcher(argv[1]);
+    int runs = argc>2 ? static_cast<int>(wcstol(argv[2], nullptr, 10)) : 200;
+    if (runs<1)
+        runs = 200;
+
+    /* our fake sandboxie and steam */
+    wchar_t tempBuffer[MAX_PATH];
+    GetTempPathW(MAX_PATH, tempBuffer);
+    wstring folder(tempBuffer);
+    folder.append(TEXT("SandboxLauncherBench"));
+    CreateDirectoryW(folder.data(), nullptr);
+
+    wstring appData(folder);
+    appData.append(TEXT("\\AppData"));
+    CreateDirectoryW(appData.data(), nullptr);
+
+    wstring fakeStart(folder + TEXT("\\Start.exe"));
+    wstring fakeSteam(folder + TEXT("\\Steam.exe"));
+    if (!CopyFileW(self.data(), fakeStart.data(), FALSE) || !CopyFileW(self.data(), fakeSteam.data(), FALSE))
+    {
+        wcout << "Could not create the fake Start.exe/Steam.exe in " << folder << endl;
+        return 1;
+    }
+
+    wstring ini(folder + TEXT("\\Sandboxie.ini"));
+    HANDLE iniFile = CreateFileW(ini.data(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (iniFile!=INVALID_HANDLE_VALUE)
+    {
+        const wchar_t content[] = L"\xFEFF[Bench]\r\nEnabled=y\r\n";
+        DWORD written;
+        WriteFile(iniFile, content, sizeof(content) - sizeof(wchar_t), &written, nullptr);
+        CloseHandle(iniFile);
+    }
+
+    wstring eventName(TEXT("Local\\SandboxLauncherBench."));
+    eventName.append(to_wstring(GetCurrentProcessId()));
+    HANDLE event = CreateEventW(nullptr, FALSE, FALSE, eventName.data());
+
+    SetEnvironmentVariableW(eventVariable, eventName.data());
+    SetEnvironmentVariableW(TEXT("LOCALAPPDATA"), appData.data());
+
+    SECURITY_ATTRIBUTES inherit = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+    HANDLE nul = CreateFileW(TEXT("NUL"), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &inherit,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    /* paths without trailing \ so the quotes are not escaped, the launcher adds it */
+    wstring launch(TEXT("\""));
+    launch.append(launcher);
+    launch.append(TEXT("\" \"/sandboxie:"));
+    launch.append(folder);
+    launch.append(TEXT("\" \"/steam:"));
+    launch.append(folder);
+    launch.append(TEXT("\" /box:Bench /terminate /noexec"));
+
+    wstring baseline(TEXT("\""));
+    baseline.append(fakeStart);
+    baseline.append(TEXT("\""));
+
+    wcout << "Startup benchmark, " << runs << " runs (+" << warmupRuns << " warmup) of:" << endl
+          << launch << endl << endl;
+
+    vector<double> baseTimes, spawnTimes, exitTimes;
+    int failed = 0;
+    for (int run = -warmupRuns; run<runs; run++)
+    {
+        double total;
+        double base = timeRun(baseline, event, nul, total);
+        double spawn = timeRun(launch, event, nul, total);
+        if (run<0)
+            continue;
+
+        if (base<0 || spawn<0)
+        {
+            failed++;
+            continue;
+        }
+
+        baseTimes.push_back(base);
+        spawnTimes.push_back(spawn - base);
+        exitTimes.push_back(total);
+    }
+
+    wcout << left << setw(24) << "ms" << right << setw(10) << "min" << setw(10) << "p50" << setw(10) << "p90"
+          << setw(10) << "p99" << setw(10) << "max" << setw(10) << "mean" << endl;
+    printTimes(TEXT("exec to first spawn"), spawnTimes);
+    printTimes(TEXT("exec to exit"), exitTimes);
+    printTimes(TEXT("(fake child baseline)"), baseTimes);
+
+    if (failed)
+        wcout << endl << failed << " runs never reached the first spawn, check the launcher on its own." << endl;
+
+    CloseHandle(nul);
+    CloseHandle(event);
+    return failed ? 1 : 0;
+}
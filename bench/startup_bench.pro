@@ -0,0 +1,35 @@
+#**************************************************************************
+#    startup_bench.pro
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+#
+#    File startup_bench.pro created by afischer on 18.10.2026
+#**************************************************************************
+
+# Measures how long SandboxLauncher.exe takes from being started until it
+# starts its first process. See startup_bench.cpp for how to run it.
+
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+QMAKE_CXXFLAGS_RELEASE += /MT
+
+SOURCES += \
+    startup_bench.cpp
+
+win32: LIBS += -lkernel32
@@ -0,0 +1,114 @@
+/**************************************************************************
+    boxlock.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File boxlock.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <algorithm>
+#include <wctype.h>
+
+#include "boxlock.h"
+
+using namespace std;
+
+/* The mutex we currently own and its name, there is only ever one lock per process */
+static HANDLE _hBoxLock = nullptr;
+static wstring _boxLockName;
+
+/*
+ * Sandboxie box names are case insensitive, so the mutex name has to be too.
+ * Global\ so launches from scheduled tasks or other sessions are ordered as well.
+ */
+wstring boxLockName(const wstring &box)
+{
+    wstring name(box);
+    transform(name.begin(), name.end(), name.begin(), ::towlower);
+    replace(name.begin(), name.end(), L'\\', L'_');
+
+    wstring lockName(TEXT("Global\\SandboxLauncher.Box."));
+    lockName.append(name);
+    return lockName;
+}
+
+/*
+ * Waits up to timeout ms for the box. If the last owner died while holding the
+ * lock we still get it, but abandoned tells the caller the box might be in a
+ * half terminated or cleared state. Asking again for the lock we hold is fine,
+ * asking for another one while holding one fails with ERROR_POSSIBLE_DEADLOCK.
+ */
+void boxLock(const wstring &box, DWORD timeout, bool &ok, bool &abandoned, DWORD &errorCode)
+{
+    ok = true;
+    abandoned = false;
+    errorCode = 0;
+
+    wstring name = boxLockName(box);
+    if (_hBoxLock)
+    {
+        if (name!=_boxLockName)
+        {
+            ok = false;
+            errorCode = ERROR_POSSIBLE_DEADLOCK;
+        }
+        return;
+    }
+
+    HANDLE handle = CreateMutexW(nullptr, FALSE, name.data());
+    if (handle==nullptr)
+    {
+        ok = false;
+        errorCode = GetLastError();
+        return;
+    }
+
+    switch (WaitForSingleObject(handle, timeout))
+    {
+    case WAIT_ABANDONED:
+        abandoned = true;
+        _hBoxLock = handle;
+        _boxLockName = name;
+        return;
+    case WAIT_OBJECT_0:
+        _hBoxLock = handle;
+        _boxLockName = name;
+        return;
+    case WAIT_TIMEOUT:
+        errorCode = ERROR_TIMEOUT;
+        break;
+    default:
+        errorCode = GetLastError();
+        break;
+    }
+
+    ok = false;
+    CloseHandle(handle);
+}
+
+/* Releases the box again. Safe to call if we never got it */
+void boxUnlock()
+{
+    if (_hBoxLock)
+    {
+        ReleaseMutex(_hBoxLock);
+        CloseHandle(_hBoxLock);
+        _hBoxLock = nullptr;
+        _boxLockName.clear();
+    }
+}
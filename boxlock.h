@@ -0,0 +1,45 @@
+#ifndef BOXLOCK_H
+#define BOXLOCK_H
+
+/**************************************************************************
+    boxlock.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File boxlock.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Cross process lock per sandbox. Every launcher instance working on the
+ * same box waits for the others, instances working on different boxes
+ * never see each other. One named mutex per box, so nothing global.
+ */
+
+#include <Windows.h>
+#include <string>
+
+using namespace std;
+
+/* Default time we wait for another instance working on the same box */
+#define BOXLOCK_DEFAULT_TIMEOUT 120000
+/* Longest wait /locktimeout accepts, one day */
+#define BOXLOCK_MAX_TIMEOUT 86400000
+
+wstring boxLockName(const wstring &box);
+void boxLock(const wstring &box, DWORD timeout, bool &ok, bool &abandoned, DWORD &errorCode);
+void boxUnlock();
+
+#endif // BOXLOCK_H
@@ -0,0 +1,250 @@
+/**************************************************************************
+    capture.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File capture.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+#include "capture.h"
+#include "utf.h"
+
+using namespace std;
+
+/* overlapped has to stay the first member, the completion gives us its address */
+struct Capture
+{
+    OVERLAPPED overlapped;
+    HANDLE pipe;
+    HANDLE log;
+    char buffer[CAPTURE_BUFFER];
+};
+
+static INIT_ONCE _captureInitOnce = INIT_ONCE_STATIC_INIT;
+static HANDLE _completionPort = nullptr;
+static HANDLE _ioThread = nullptr;
+static HANDLE _idleEvent = nullptr;
+/* _activeCaptures and _idleEvent change together under the lock, or a new capture could see a stale idle */
+static CRITICAL_SECTION _captureLock;
+static LONG _activeCaptures = 0;
+static LONG _pipeCount = 0;
+
+static void captureFinish(Capture *capture)
+{
+    CloseHandle(capture->pipe);
+    CloseHandle(capture->log);
+    delete capture;
+
+    EnterCriticalSection(&_captureLock);
+    if (--_activeCaptures==0)
+        SetEvent(_idleEvent);
+    LeaveCriticalSection(&_captureLock);
+}
+
+/* Queues the next read, the result comes through the completion port even if it is done right away */
+static bool captureRead(Capture *capture)
+{
+    ZeroMemory(&capture->overlapped, sizeof(capture->overlapped));
+    if (ReadFile(capture->pipe, capture->buffer, CAPTURE_BUFFER, nullptr, &capture->overlapped))
+        return true;
+    return GetLastError()==ERROR_IO_PENDING;
+}
+
+static DWORD WINAPI captureThread(LPVOID)
+{
+    for (;;)
+    {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED *overlapped = nullptr;
+        BOOL result = GetQueuedCompletionStatus(_completionPort, &bytes, &key, &overlapped, INFINITE);
+        if (!overlapped)
+            break;
+
+        Capture *capture = reinterpret_cast<Capture *>(overlapped);
+        if (result && bytes)
+        {
+            DWORD written;
+            WriteFile(capture->log, capture->buffer, bytes, &written, nullptr);
+        }
+
+        /* a failed read is the end of it, mostly ERROR_BROKEN_PIPE when the last writer is gone */
+        if (!result || !captureRead(capture))
+            captureFinish(capture);
+    }
+
+    return 0;
+}
+
+/*
+ * Done once for all threads that capture, if it fails the next capture tries
+ * again. Anything already made is kept, the lock is set up with the event so
+ * it is never set up twice.
+ */
+static BOOL CALLBACK captureInitOnce(PINIT_ONCE, PVOID param, PVOID *)
+{
+    if (!_completionPort)
+        _completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (!_idleEvent)
+    {
+        _idleEvent = CreateEventW(nullptr, TRUE, TRUE, nullptr);
+        if (_idleEvent)
+            InitializeCriticalSection(&_captureLock);
+    }
+    if (_completionPort && _idleEvent)
+        _ioThread = CreateThread(nullptr, 0, captureThread, nullptr, 0, nullptr);
+
+    if (!_ioThread)
+        *static_cast<DWORD *>(param) = GetLastError();
+    return _ioThread!=nullptr;
+}
+
+static void captureInit(bool &ok, DWORD &errorCode)
+{
+    ok = InitOnceExecuteOnce(&_captureInitOnce, captureInitOnce, &errorCode, nullptr)!=FALSE;
+}
+
+static void writeHeader(HANDLE log, const wstring &title)
+{
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+
+    wchar_t stamp[32];
+    swprintf(stamp, 32, L"%04u-%02u-%02u %02u:%02u:%02u ", now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond);
+
+    string header("--- ");
+    header.append(wideToUtf8(stamp + title));
+    header.append(" ---\r\n");
+
+    DWORD written;
+    WriteFile(log, header.data(), static_cast<DWORD>(header.size()), &written, nullptr);
+}
+
+/*
+ * Same as CreateProcessW, but with stdout and stderr going to logName. The
+ * title is written to the log before, with the time. Never put the command
+ * line there, it can hold the Steam password.
+ *
+ * captured is false if log or pipe could not be set up, then nothing was
+ * started and the caller should start the program without us. Otherwise ok
+ * and errorCode tell how CreateProcessW went.
+ */
+void captureProcess(const wstring &command, const wstring &logName, const wstring &title,
+                    PROCESS_INFORMATION &pi, bool &captured, bool &ok, DWORD &errorCode)
+{
+    ZeroMemory(&pi, sizeof(pi));
+    captured = false;
+
+    captureInit(ok, errorCode);
+    if (!ok)
+        return;
+
+    Capture *capture = new Capture();
+    capture->log = CreateFileW(logName.data(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                               OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (capture->log==INVALID_HANDLE_VALUE)
+    {
+        ok = false;
+        errorCode = GetLastError();
+        delete capture;
+        return;
+    }
+    writeHeader(capture->log, title);
+
+    wstring pipeName(TEXT("\\\\.\\pipe\\SandboxLauncher."));
+    pipeName.append(to_wstring(GetCurrentProcessId()));
+    pipeName.append(TEXT("."));
+    pipeName.append(to_wstring(++_pipeCount));
+
+    capture->pipe = CreateNamedPipeW(pipeName.data(), PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                                     PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                     1, 0, CAPTURE_BUFFER, 0, nullptr);
+
+    SECURITY_ATTRIBUTES inherit;
+    inherit.nLength = sizeof(inherit);
+    inherit.lpSecurityDescriptor = nullptr;
+    inherit.bInheritHandle = TRUE;
+
+    HANDLE childOutput = INVALID_HANDLE_VALUE;
+    if (capture->pipe!=INVALID_HANDLE_VALUE)
+        childOutput = CreateFileW(pipeName.data(), GENERIC_WRITE, 0, &inherit, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (childOutput==INVALID_HANDLE_VALUE ||
+            !CreateIoCompletionPort(capture->pipe, _completionPort, 0, 0))
+    {
+        ok = false;
+        errorCode = GetLastError();
+        if (childOutput!=INVALID_HANDLE_VALUE)
+            CloseHandle(childOutput);
+        if (capture->pipe!=INVALID_HANDLE_VALUE)
+            CloseHandle(capture->pipe);
+        CloseHandle(capture->log);
+        delete capture;
+        return;
+    }
+
+    /* only the pipe is passed on, not whatever else we have open */
+    SIZE_T size = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &size);
+    vector<char> attributes(size);
+    LPPROC_THREAD_ATTRIBUTE_LIST attributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributes.data());
+    InitializeProcThreadAttributeList(attributeList, 1, 0, &size);
+    UpdateProcThreadAttribute(attributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &childOutput, sizeof(childOutput), nullptr, nullptr);
+
+    STARTUPINFOEXW si;
+    ZeroMemory(&si, sizeof(si));
+    si.StartupInfo.cb = sizeof(si);
+    si.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    si.StartupInfo.hStdOutput = childOutput;
+    si.StartupInfo.hStdError = childOutput;
+    si.lpAttributeList = attributeList;
+
+    captured = true;
+    wstring commandLine(command);
+    ok = CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, TRUE, EXTENDED_STARTUPINFO_PRESENT,
+                        nullptr, nullptr, &si.StartupInfo, &pi);
+    if (!ok)
+        errorCode = GetLastError();
+
+    DeleteProcThreadAttributeList(attributeList);
+
+    /* the child has its own copy now, once it is gone the read fails with a broken pipe */
+    CloseHandle(childOutput);
+
+    EnterCriticalSection(&_captureLock);
+    if (_activeCaptures++==0)
+        ResetEvent(_idleEvent);
+    LeaveCriticalSection(&_captureLock);
+
+    if (!captureRead(capture))
+        captureFinish(capture);
+}
+
+/*
+ * Waits until all captured programs closed their output. Programs started
+ * by them may hold on to it for much longer, so this is only worth a short
+ * timeout. Returns false if something is still writing.
+ */
+bool captureWait(DWORD timeout)
+{
+    if (!_idleEvent)
+        return true;
+    return WaitForSingleObject(_idleEvent, timeout)==WAIT_OBJECT_0;
+}
@@ -0,0 +1,45 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+/**************************************************************************
+    capture.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File capture.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Starts a program with its stdout and stderr going into a log file instead
+ * of our console. Every program gets its own pipe and only that pipe is
+ * inherited. One background thread serves all pipes with overlapped reads
+ * on a completion port and appends whatever comes in to the log.
+ */
+
+#include <Windows.h>
+#include <string>
+
+using namespace std;
+
+#define CAPTURE_BUFFER 65536
+/* How long to wait for the rest of the output after the program ended */
+#define CAPTURE_DRAIN_TIMEOUT 2000
+
+void captureProcess(const wstring &command, const wstring &logName, const wstring &title,
+                    PROCESS_INFORMATION &pi, bool &captured, bool &ok, DWORD &errorCode);
+bool captureWait(DWORD timeout);
+
+#endif // CAPTURE_H
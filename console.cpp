@@ -21,22 +21,28 @@
 
 #include <Windows.h>
 #include <string>
-#include <iostream>
 #include <stack>
 
 #include "console.h"
+#include "utf.h"
 
 using namespace std;
 
 /*
  * Some statics to keep track of the console state and if we actualy got
- * a valid init
+ * a valid init. Only plain data here, the stack is created on first use
+ * so there is nothing to construct before wmain.
  */
 static HANDLE _hConsole;
-static CONSOLE_SCREEN_BUFFER_INFO *_consoleInfo;
+static CONSOLE_SCREEN_BUFFER_INFO _consoleInfo;
 static WORD _consoleAttributes;
 static bool _consoleInit = false;
-static stack<WORD> _consoleStates;
+
+static stack<WORD> &consoleStates()
+{
+    static stack<WORD> states;
+    return states;
+}
 
 /* Should only be called once at app start. Saves the state of the current console.*/
 void consoleInit()
@@ -48,10 +54,9 @@ void consoleInit()
     if (_hConsole==INVALID_HANDLE_VALUE || _hConsole==nullptr)
         return;
 
-    _consoleInfo = new CONSOLE_SCREEN_BUFFER_INFO();
-    _consoleInit = GetConsoleScreenBufferInfo(_hConsole, _consoleInfo);
+    _consoleInit = GetConsoleScreenBufferInfo(_hConsole, &_consoleInfo);
     if (_consoleInit)
-        _consoleAttributes = _consoleInfo->wAttributes;
+        _consoleAttributes = _consoleInfo.wAttributes;
 }
 
 /* Resets the console to app start and clears the stack of saved console states */
@@ -59,7 +64,7 @@ void consoleReset()
 {
     if (_consoleInit)
     {
-        _consoleStates = stack<WORD>();
+        consoleStates() = stack<WORD>();
         SetConsoleTextAttribute(_hConsole, _consoleAttributes);
     }
 }
@@ -76,17 +81,53 @@ void consoleAttribute(unsigned short fg, unsigned short bg)
 void consolePrint(const wstring &text, unsigned short fg, unsigned short bg)
 {
     consolePush(fg, bg);
-    wcout << text;
+    consoleWrite(text);
     consolePop();
 }
 
+/*
+ * Writes straight to the console without going through iostreams. If the output
+ * is redirected to a file or a pipe it goes there as UTF-8.
+ */
+void consoleWrite(const wstring &text)
+{
+    DWORD mode;
+    DWORD written;
+    HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (handle==INVALID_HANDLE_VALUE || handle==nullptr)
+        return;
+
+    if (GetConsoleMode(handle, &mode))
+        WriteConsoleW(handle, text.data(), static_cast<DWORD>(text.length()), &written, nullptr);
+    else
+    {
+        string data = wideToUtf8(text);
+        WriteFile(handle, data.data(), static_cast<DWORD>(data.length()), &written, nullptr);
+    }
+}
+
+/* Pads the text with spaces to at least width characters, for the tables of /status, /stats and /controller */
+wstring consolePad(const wstring &text, size_t width, bool alignRight)
+{
+    if (text.length()>=width)
+        return text;
+
+    wstring padded;
+    if (!alignRight)
+        padded.append(text);
+    padded.append(width - text.length(), TEXT(' '));
+    if (alignRight)
+        padded.append(text);
+    return padded;
+}
+
 /* Saves the current attributes on the console stack */
 void consolePush()
 {
     if (_consoleInit)
     {
-        GetConsoleScreenBufferInfo(_hConsole, _consoleInfo);
-        _consoleStates.push(_consoleInfo->wAttributes);
+        GetConsoleScreenBufferInfo(_hConsole, &_consoleInfo);
+        consoleStates().push(_consoleInfo.wAttributes);
     }
 }
 
@@ -103,10 +144,10 @@ void consolePop()
 {
     if (_consoleInit)
     {
-        if (!_consoleStates.empty())
+        if (!consoleStates().empty())
         {
-            WORD colorAttrib = _consoleStates.top();
-            _consoleStates.pop();
+            WORD colorAttrib = consoleStates().top();
+            consoleStates().pop();
             SetConsoleTextAttribute(_hConsole, colorAttrib);
         } else {
             consoleReset();
@@ -119,7 +160,12 @@ Console *Console::_instance = nullptr;
 HANDLE Console::_hConsole = INVALID_HANDLE_VALUE;
 CONSOLE_SCREEN_BUFFER_INFO *Console::_consoleInfo = nullptr;
 WORD Console::_consoleAttributes = 0;
-stack<WORD> Console::_consoleStates = stack<WORD>();
+
+stack<WORD> &Console::consoleStates()
+{
+    static stack<WORD> states;
+    return states;
+}
 
 const Console *Console::instance()
 {
@@ -157,7 +203,7 @@ void Console::pushColor(unsigned int fg, unsigned int bg)
     {
         WORD colorAttrib = static_cast<WORD>((bg & 0x0F) << 4) + (fg & 0x0F);
         GetConsoleScreenBufferInfo(_hConsole, _consoleInfo);
-        _consoleStates.push(_consoleInfo->wAttributes);
+        consoleStates().push(_consoleInfo->wAttributes);
         setAttribute(colorAttrib);
     }
 }
@@ -166,10 +212,10 @@ void Console::popColor()
 {
     if (_consoleInit)
     {
-        if (!_consoleStates.empty())
+        if (!consoleStates().empty())
         {
-            WORD colorAttrib = _consoleStates.top();
-            _consoleStates.pop();
+            WORD colorAttrib = consoleStates().top();
+            consoleStates().pop();
             setAttribute(colorAttrib);
         } else {
             resetAttribute();
@@ -201,7 +247,7 @@ void Console::resetAttribute()
 {
     if (_consoleInit)
     {
-        _consoleStates = stack<WORD>();
+        consoleStates() = stack<WORD>();
         SetConsoleTextAttribute(_hConsole, _consoleAttributes);
     }
 }
@@ -215,11 +261,11 @@ void Console::setAttribute(WORD colorAttribute)
 Console::Console()
 {
     initAttribute();
-    wcout << endl << "Init" << endl;
+    consoleWrite(TEXT("\nInit\n"));
 }
 
 Console::~Console()
 {
     resetAttribute();
-    wcout << endl << "Destroy" << endl;
+    consoleWrite(TEXT("\nDestroy\n"));
 }
@@ -58,7 +58,7 @@ private:
     static HANDLE _hConsole;
     static CONSOLE_SCREEN_BUFFER_INFO *_consoleInfo;
     static WORD _consoleAttributes;
-    static stack<WORD> _consoleStates;
+    static stack<WORD> &consoleStates();
 };
 
 #define BLACK			0
@@ -87,6 +87,8 @@ void consolePush(unsigned short fg, unsigned short bg = 0);
 void consolePop();
 void consoleAttribute(unsigned short fg, unsigned short bg = 0);
 void consolePrint(const wstring &text, unsigned short fg, unsigned short bg = 0);
+void consoleWrite(const wstring &text);
+wstring consolePad(const wstring &text, size_t width, bool alignRight = false);
 
 
 #endif // CONSOLE_H
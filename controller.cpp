@@ -0,0 +1,348 @@
+/**************************************************************************
+    controller.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File controller.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <WinSock2.h>
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <wctype.h>
+
+#include "controller.h"
+#include "agent.h"
+#include "console.h"
+#include "failure.h"
+#include "storage.h"
+#include "utf.h"
+
+using namespace std;
+
+struct ControllerEntry
+{
+    wstring args;
+    wstring box;
+    wstring agent;
+    wstring reply;
+    Failure failure;
+    unsigned int attempts;
+    ULONGLONG notBefore;
+};
+
+struct ControllerAgent
+{
+    wstring address;
+    unsigned int free;
+};
+
+/* The manifest lines and the ones still to launch, handed out to the agent threads */
+static vector<ControllerEntry> _entries;
+static deque<size_t> _queue;
+/* Slot threads still taking lines, the last one stays until nothing is queued */
+static unsigned int _slotsRunning = 0;
+static wstring _token;
+static CRITICAL_SECTION _controllerLock;
+
+static DWORD WINAPI agentStatusThread(LPVOID param)
+{
+    ControllerAgent *agent = static_cast<ControllerAgent *>(param);
+    agent->free = 0;
+
+    bool ok;
+    DWORD errorCode;
+    wstring reply;
+    agentRequest(agent->address, _token, TEXT("STATUS"), reply, ok, errorCode);
+
+    unsigned long running = 0;
+    unsigned long capacity = 0;
+    if (ok && reply.compare(0, 3, TEXT("OK "))==0)
+    {
+        wchar_t *end;
+        running = wcstoul(reply.data() + 3, &end, 10);
+        capacity = wcstoul(end, nullptr, 10);
+        agent->free = capacity>running ? static_cast<unsigned int>(capacity - running) : 0;
+    }
+
+    EnterCriticalSection(&_controllerLock);
+    if (ok)
+        consoleWrite(agent->address + TEXT(": ") + to_wstring(running) + TEXT(" of ") + to_wstring(capacity) + TEXT(" running\n"));
+    else
+        consoleWrite(agent->address + TEXT(": not reachable, Windows error ") + to_wstring(errorCode) + TEXT("\n"));
+    LeaveCriticalSection(&_controllerLock);
+    return 0;
+}
+
+/* What the answer of the agent means, BUSY is transient for this agent only */
+static Failure classifyReply(const wstring &reply)
+{
+    if (reply.compare(0, 3, TEXT("OK "))==0)
+        return classifyLaunchExit(wcstoul(reply.data() + 3, nullptr, 10));
+    if (reply.compare(0, 4, TEXT("ERR "))==0)
+        return classifyError(wcstoul(reply.data() + 4, nullptr, 10));
+    if (reply==TEXT("BUSY"))
+        return Failure::Transient;
+    return Failure::Permanent;
+}
+
+/*
+ * Takes the next line that is due. If there are only lines waiting for a
+ * retry, wait tells how long until the first one is due. If nothing is
+ * queued at all the calling slot is done and no longer counted as running.
+ */
+static bool nextEntry(size_t &idx, DWORD &wait)
+{
+    wait = 0;
+    ULONGLONG now = GetTickCount64();
+    ULONGLONG due = 0;
+
+    EnterCriticalSection(&_controllerLock);
+    bool found = false;
+    for (auto pos = _queue.begin(); pos!=_queue.end(); ++pos)
+    {
+        const ControllerEntry &entry = _entries.at(*pos);
+        if (entry.notBefore<=now)
+        {
+            idx = *pos;
+            _queue.erase(pos);
+            found = true;
+            break;
+        }
+        if (due==0 || entry.notBefore<due)
+            due = entry.notBefore;
+    }
+    if (!found && due==0)
+        _slotsRunning--;
+    LeaveCriticalSection(&_controllerLock);
+
+    if (!found && due)
+        wait = static_cast<DWORD>(due - now);
+    return found;
+}
+
+/*
+ * One of these runs per free slot of an agent, taking lines until there are
+ * none left. A transient failure goes back into the queue with a delay, so
+ * this slot and all others go on with the next line meanwhile. A BUSY agent
+ * gives up the slot, unless it is the last one running, the queued line
+ * would be left behind then.
+ */
+static DWORD WINAPI agentLaunchThread(LPVOID param)
+{
+    ControllerAgent *agent = static_cast<ControllerAgent *>(param);
+
+    for (;;)
+    {
+        size_t idx;
+        DWORD wait;
+        if (!nextEntry(idx, wait))
+        {
+            if (wait==0)
+                break;
+            Sleep(wait);
+            continue;
+        }
+
+        ControllerEntry &entry = _entries.at(idx);
+        entry.agent = agent->address;
+        entry.attempts++;
+
+        bool ok;
+        DWORD errorCode;
+        wstring reply;
+        agentRequest(agent->address, _token, TEXT("LAUNCH ") + entry.args, reply, ok, errorCode);
+        if (!ok)
+            reply = TEXT("ERR ") + to_wstring(errorCode);
+        Failure failure = classifyReply(reply);
+
+        EnterCriticalSection(&_controllerLock);
+        entry.reply = reply;
+        entry.failure = failure;
+
+        bool retry = failure==Failure::Transient && entry.attempts<=FAILURE_RETRIES;
+        if (retry)
+        {
+            DWORD delay = retryDelay(entry.attempts);
+            entry.notBefore = GetTickCount64() + delay;
+            _queue.push_back(idx);
+            consoleWrite(TEXT("retry  ") + entry.agent + TEXT("\t") + reply + TEXT("\t") + entry.box + TEXT(" in ") + to_wstring(delay) + TEXT(" ms\n"));
+        } else {
+            consoleWrite((failure==Failure::None ? TEXT("done   ") : TEXT("failed ")) + entry.agent + TEXT("\t") + reply + TEXT("\t") + entry.box + TEXT("\n"));
+        }
+
+        /* the agent is fuller than it told us, leave the rest to the others if there are any */
+        bool leave = reply==TEXT("BUSY") && _slotsRunning>1;
+        if (leave)
+            _slotsRunning--;
+        LeaveCriticalSection(&_controllerLock);
+
+        if (leave)
+            break;
+    }
+
+    return 0;
+}
+
+/* The /box of a manifest line, for the summary */
+static wstring entryBox(const wstring &args)
+{
+    wstring lower(args);
+    transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
+
+    size_t pos = lower.find(TEXT("/box:"));
+    if (pos==wstring::npos)
+        return TEXT("Default");
+
+    pos += 5;
+    if (pos<args.length() && args.at(pos)=='"')
+        return args.substr(pos + 1, args.find('"', pos + 1) - pos - 1);
+    return args.substr(pos, args.find(' ', pos) - pos);
+}
+
+static void waitThreads(vector<HANDLE> &threads)
+{
+    for (HANDLE thread : threads)
+    {
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    }
+    threads.clear();
+}
+
+/*
+ * ok is false if the manifest can not be read, no agent is there or a launch
+ * failed. exitCode is what our process should end with, see failure.h.
+ */
+void controllerRun(const wstring &manifest, const vector<wstring> &agents, const wstring &token, bool &ok, DWORD &errorCode,
+                   int &exitCode)
+{
+    string data;
+    readFile(manifest, data, ok, errorCode);
+    if (!ok)
+    {
+        exitCode = LAUNCH_EXIT_NOT_FOUND;
+        return;
+    }
+
+    _token = token;
+    _entries.clear();
+    _queue.clear();
+    _slotsRunning = 0;
+    exitCode = LAUNCH_EXIT_OK;
+
+    wstring text = utf8ToWide(data);
+    size_t pos = 0;
+    while (pos<text.length())
+    {
+        size_t end = text.find('\n', pos);
+        if (end==wstring::npos)
+            end = text.length();
+
+        wstring line = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t first = line.find_first_not_of(TEXT(" \t\r"));
+        if (first==wstring::npos || line.at(first)=='#')
+            continue;
+        line = line.substr(first, line.find_last_not_of(TEXT(" \t\r")) - first + 1);
+
+        ControllerEntry entry;
+        entry.args = line;
+        entry.box = entryBox(line);
+        entry.failure = Failure::Transient;
+        entry.reply = TEXT("no free agent");
+        entry.attempts = 0;
+        entry.notBefore = 0;
+        _queue.push_back(_entries.size());
+        _entries.push_back(entry);
+    }
+
+    WSADATA wsaData;
+    errorCode = static_cast<DWORD>(WSAStartup(MAKEWORD(2, 2), &wsaData));
+    if (errorCode!=0)
+    {
+        ok = false;
+        exitCode = LAUNCH_EXIT_RETRY;
+        return;
+    }
+    InitializeCriticalSection(&_controllerLock);
+
+    /* ask everyone at once how much they can take */
+    vector<ControllerAgent> agentList(agents.size());
+    vector<HANDLE> threads;
+    for (size_t idx = 0; idx<agents.size(); idx++)
+    {
+        agentList.at(idx).address = agents.at(idx);
+        HANDLE thread = CreateThread(nullptr, 0, agentStatusThread, &agentList.at(idx), 0, nullptr);
+        if (thread)
+            threads.push_back(thread);
+    }
+    waitThreads(threads);
+
+    size_t entryCount = _entries.size();
+    unsigned int slots = 0;
+    for (ControllerAgent &agent : agentList)
+    {
+        for (unsigned int slot = 0; slot<agent.free && slot<entryCount; slot++)
+        {
+            EnterCriticalSection(&_controllerLock);
+            _slotsRunning++;
+            LeaveCriticalSection(&_controllerLock);
+
+            HANDLE thread = CreateThread(nullptr, 0, agentLaunchThread, &agent, 0, nullptr);
+            if (thread)
+            {
+                threads.push_back(thread);
+                slots++;
+            } else {
+                EnterCriticalSection(&_controllerLock);
+                _slotsRunning--;
+                LeaveCriticalSection(&_controllerLock);
+            }
+        }
+    }
+    waitThreads(threads);
+
+    /* one line per box, permanent failures make the exit code over transient ones */
+    unsigned int done = 0;
+    consoleWrite(TEXT("\n") + consolePad(TEXT("Sandbox"), 24) + consolePad(TEXT("Result"), 12) + consolePad(TEXT("Attempts"), 10)
+                 + consolePad(TEXT("Agent"), 24) + TEXT("Answer\n"));
+    for (const ControllerEntry &entry : _entries)
+    {
+        consoleWrite(consolePad(entry.box, 24) + consolePad(entry.failure==Failure::None ? TEXT("ok") : failureName(entry.failure), 12)
+                     + consolePad(to_wstring(entry.attempts), 10) + consolePad(entry.agent.empty() ? wstring(TEXT("-")) : entry.agent, 24)
+                     + entry.reply + TEXT("\n"));
+
+        if (entry.failure==Failure::None)
+            done++;
+        else if (entry.failure==Failure::Permanent)
+            exitCode = LAUNCH_EXIT_FAILED;
+        else if (exitCode==LAUNCH_EXIT_OK)
+            exitCode = LAUNCH_EXIT_RETRY;
+    }
+    consoleWrite(TEXT("\n") + to_wstring(done) + TEXT(" of ") + to_wstring(entryCount) + TEXT(" launches done on ") + to_wstring(slots) + TEXT(" slots\n"));
+
+    /* failed launches are no windows error, they are listed above */
+    ok = done==entryCount;
+    errorCode = 0;
+
+    DeleteCriticalSection(&_controllerLock);
+    WSACleanup();
+}
@@ -0,0 +1,44 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+/**************************************************************************
+    controller.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File controller.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Spreads the launches of a manifest over a bunch of agents (see agent.h).
+ * The manifest is a text file with the launcher arguments of one launch per
+ * line, like "/box:Account1 /id:730 /user:name /clear". Agents only take the
+ * arguments listed in agent.cpp (remoteAllowed), paths are set on the agent's
+ * own command line. Every agent is asked for its free capacity first and then
+ * gets that many launches at a time, all agents in parallel. Whoever is done first takes the next line. A line
+ * that failed for a reason that may go away is tried again a bit later.
+ */
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+void controllerRun(const wstring &manifest, const vector<wstring> &agents, const wstring &token, bool &ok, DWORD &errorCode,
+                   int &exitCode);
+
+#endif // CONTROLLER_H
@@ -0,0 +1,163 @@
+/**************************************************************************
+    failure.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File failure.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <WinSock2.h>
+#include <Windows.h>
+#include <algorithm>
+
+#include "failure.h"
+
+using namespace std;
+
+/* Windows and Winsock errors that come and go, everything else is permanent */
+static const DWORD transientErrors[] = {
+                                    ERROR_NOT_ENOUGH_MEMORY,
+                                    ERROR_OUTOFMEMORY,
+                                    ERROR_SHARING_VIOLATION,
+                                    ERROR_LOCK_VIOLATION,
+                                    ERROR_SEM_TIMEOUT,
+                                    ERROR_BUSY,
+                                    ERROR_PIPE_BUSY,
+                                    WAIT_TIMEOUT,
+                                    ERROR_SERVICE_NOT_ACTIVE,
+                                    ERROR_RETRY,
+                                    ERROR_TIMEOUT,
+                                    ERROR_NO_SYSTEM_RESOURCES,
+                                    ERROR_NONPAGED_SYSTEM_RESOURCES,
+                                    ERROR_PAGED_SYSTEM_RESOURCES,
+                                    ERROR_COMMITMENT_LIMIT,
+                                    WSAENETDOWN,
+                                    WSAENETUNREACH,
+                                    WSAENETRESET,
+                                    WSAECONNABORTED,
+                                    WSAECONNRESET,
+                                    WSAETIMEDOUT,
+                                    WSAECONNREFUSED,
+                                    WSAEHOSTDOWN,
+                                    WSAEHOSTUNREACH,
+                                    WSATRY_AGAIN
+                                  };
+
+/* NTSTATUS codes a program dies with when it can not even start, no point in trying again */
+#define STATUS_INVALID_IMAGE_FORMAT 0xC000007B
+#define STATUS_DLL_NOT_FOUND 0xC0000135
+#define STATUS_ENTRYPOINT_NOT_FOUND 0xC0000139
+
+/* one per thread, the controller's launch threads all ask for delays */
+static thread_local unsigned long long _random = 0;
+
+const wchar_t *failureName(Failure failure)
+{
+    switch (failure)
+    {
+    case Failure::None: return TEXT("ok");
+    case Failure::Transient: return TEXT("transient");
+    case Failure::Permanent: return TEXT("permanent");
+    }
+    return TEXT("unknown");
+}
+
+/* For errors of CreateProcess, waits, locks and sockets */
+Failure classifyError(DWORD errorCode)
+{
+    if (errorCode==0)
+        return Failure::None;
+
+    for (DWORD transient : transientErrors)
+        if (errorCode==transient)
+            return Failure::Transient;
+    return Failure::Permanent;
+}
+
+/*
+ * For the exit code of Start.exe. A crash (NTSTATUS error) is transient unless
+ * the program could not be loaded at all, any other exit code is Start.exe
+ * telling us it did not work, which it will tell us again.
+ */
+Failure classifyExitCode(DWORD exitCode)
+{
+    if (exitCode==0)
+        return Failure::None;
+
+    if (exitCode==STATUS_INVALID_IMAGE_FORMAT || exitCode==STATUS_DLL_NOT_FOUND || exitCode==STATUS_ENTRYPOINT_NOT_FOUND)
+        return Failure::Permanent;
+    if ((exitCode & 0xC0000000)==0xC0000000)
+        return Failure::Transient;
+    return Failure::Permanent;
+}
+
+/* For the exit code of another launcher, like the ones an agent starts */
+Failure classifyLaunchExit(DWORD exitCode)
+{
+    if (exitCode==LAUNCH_EXIT_OK)
+        return Failure::None;
+    if (exitCode==LAUNCH_EXIT_RETRY)
+        return Failure::Transient;
+    if (exitCode<=LAUNCH_EXIT_RETRY)
+        return Failure::Permanent;
+    return classifyExitCode(exitCode);
+}
+
+int failureExitCode(Failure failure)
+{
+    switch (failure)
+    {
+    case Failure::None: return LAUNCH_EXIT_OK;
+    case Failure::Transient: return LAUNCH_EXIT_RETRY;
+    case Failure::Permanent: return LAUNCH_EXIT_FAILED;
+    }
+    return LAUNCH_EXIT_FAILED;
+}
+
+/* Same for a Windows error, a missing file or path has its own exit code */
+int errorExitCode(DWORD errorCode)
+{
+    if (errorCode==ERROR_FILE_NOT_FOUND || errorCode==ERROR_PATH_NOT_FOUND)
+        return LAUNCH_EXIT_NOT_FOUND;
+    return failureExitCode(classifyError(errorCode));
+}
+
+/*
+ * Delay before retry number attempt (1 based). Somewhere between half and all
+ * of the doubled delay, so launchers that failed together don't retry together.
+ */
+DWORD retryDelay(unsigned int attempt)
+{
+    if (_random==0)
+    {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        _random = static_cast<unsigned long long>(counter.QuadPart) ^ (static_cast<unsigned long long>(GetCurrentProcessId()) << 32)
+                ^ (static_cast<unsigned long long>(GetCurrentThreadId()) << 16) ^ 0x9E3779B97F4A7C15ull;
+    }
+
+    /* xorshift64 */
+    _random ^= _random << 13;
+    _random ^= _random >> 7;
+    _random ^= _random << 17;
+
+    DWORD delay = FAILURE_DELAY_MIN;
+    for (unsigned int idx = 1; idx<attempt && delay<FAILURE_DELAY_MAX; idx++)
+        delay *= 2;
+    delay = min(delay, static_cast<DWORD>(FAILURE_DELAY_MAX));
+
+    return delay / 2 + static_cast<DWORD>(_random % (delay / 2 + 1));
+}
@@ -0,0 +1,59 @@
+#ifndef FAILURE_H
+#define FAILURE_H
+
+/**************************************************************************
+    failure.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File failure.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Tells failures worth another try (busy, out of resources, a crashed
+ * Start.exe, network hiccups) from the ones that will fail again anyway
+ * (missing files, bad arguments, access denied). Transient ones are retried
+ * a few times with a random delay, permanent ones end the launch right away.
+ */
+
+#include <Windows.h>
+
+/* Our process exit codes, so scripts and the controller can tell what went wrong */
+#define LAUNCH_EXIT_OK 0
+#define LAUNCH_EXIT_FAILED 1        /* permanent, trying again will not help */
+#define LAUNCH_EXIT_USAGE 2         /* bad or missing arguments */
+#define LAUNCH_EXIT_NOT_FOUND 3     /* Sandboxie, Steam, the sandbox or the app is missing */
+#define LAUNCH_EXIT_RETRY 4         /* transient, trying again later may work */
+
+/* Retries of a transient failure, the delay doubles from min to max and is then jittered */
+#define FAILURE_RETRIES 3
+#define FAILURE_DELAY_MIN 500
+#define FAILURE_DELAY_MAX 15000
+
+/* Longest we wait for Start.exe, clearing a big sandbox takes a while */
+#define EXECUTE_TIMEOUT 600000
+
+enum class Failure : unsigned int { None = 0, Transient = 1, Permanent = 2 };
+
+const wchar_t *failureName(Failure failure);
+Failure classifyError(DWORD errorCode);
+Failure classifyExitCode(DWORD exitCode);
+Failure classifyLaunchExit(DWORD exitCode);
+int failureExitCode(Failure failure);
+int errorExitCode(DWORD errorCode);
+DWORD retryDelay(unsigned int attempt);
+
+#endif // FAILURE_H
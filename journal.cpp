@@ -0,0 +1,544 @@
+/**************************************************************************
+    journal.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File journal.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <wctype.h>
+#include <string.h>
+
+#include "journal.h"
+#include "storage.h"
+#include "console.h"
+
+using namespace std;
+
+#define RECORD_MAGIC 0x524A4C53 /* SLJR */
+#define SNAPSHOT_MAGIC 0x534A4C53 /* SLJS */
+#define SNAPSHOT_VERSION 2
+#define MAX_NAME 1024
+
+/*
+ * Log layout: records of RecordHeader, RecordData, box and account (wchar_t)
+ * one after the other. The crc covers everything after the header, so a
+ * record torn by a crash is skipped and reading goes on at the next magic.
+ */
+struct RecordHeader
+{
+    DWORD magic;
+    DWORD size;
+    DWORD crc;
+    DWORD reserved;
+};
+
+struct RecordData
+{
+    unsigned long long time;
+    DWORD appId;
+    DWORD pid;
+    DWORD code;
+    DWORD event;
+    DWORD boxLength;
+    DWORD accountLength;
+};
+
+/* Snapshot layout: SnapshotHeader, then per box StateData, box and account */
+struct SnapshotHeader
+{
+    DWORD magic;
+    DWORD version;
+    DWORD count;
+    DWORD crc;
+};
+
+struct StateData
+{
+    unsigned long long lastTime;
+    unsigned long long cleared;
+    unsigned long long launched;
+    unsigned long long stopped;
+    DWORD appId;
+    DWORD pid;
+    DWORD code;
+    DWORD lastEvent;
+    DWORD boxLength;
+    DWORD accountLength;
+};
+
+static const wchar_t *_eventNames[] = { TEXT("terminated"), TEXT("cleared"), TEXT("launched"), TEXT("running"),
+                                        TEXT("exited"), TEXT("failed") };
+
+/* Every box we know of, by lower case name */
+static map<wstring, BoxState> _boxes;
+/* Records of this run not written yet */
+static string _pending;
+
+const wchar_t *journalEventName(JournalEvent event)
+{
+    unsigned int idx = static_cast<unsigned int>(event);
+    return idx<sizeof(_eventNames) / sizeof(_eventNames[0]) ? _eventNames[idx] : TEXT("unknown");
+}
+
+static DWORD crc32(const char *data, size_t length)
+{
+    static DWORD table[256];
+    static bool tableInit = false;
+    if (!tableInit)
+    {
+        for (DWORD idx = 0; idx<256; idx++)
+        {
+            DWORD value = idx;
+            for (int bit = 0; bit<8; bit++)
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320 : value >> 1;
+            table[idx] = value;
+        }
+        tableInit = true;
+    }
+
+    DWORD crc = 0xFFFFFFFF;
+    for (size_t idx = 0; idx<length; idx++)
+        crc = table[(crc ^ static_cast<unsigned char>(data[idx])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static wstring boxKey(const wstring &box)
+{
+    wstring key(box);
+    transform(key.begin(), key.end(), key.begin(), ::towlower);
+    return key;
+}
+
+static void apply(map<wstring, BoxState> &boxes, JournalEvent event, unsigned long long time, const wstring &box,
+                  const wstring &account, DWORD appId, DWORD pid, DWORD code)
+{
+    wstring key = boxKey(box);
+    if (boxes.count(key)==0)
+    {
+        BoxState state;
+        state.box = box;
+        state.lastEvent = event;
+        state.lastTime = 0;
+        state.cleared = 0;
+        state.launched = 0;
+        state.stopped = 0;
+        state.appId = 0;
+        state.pid = 0;
+        state.code = 0;
+        boxes[key] = state;
+    }
+
+    BoxState &state = boxes[key];
+    state.lastEvent = event;
+    state.lastTime = time;
+
+    switch (event)
+    {
+    case JournalEvent::Cleared:
+        state.cleared = time;
+        state.stopped = time;
+        state.pid = 0;
+        break;
+    case JournalEvent::Launched:
+        state.launched = time;
+        state.account = account;
+        state.appId = appId;
+        state.pid = 0;
+        state.code = 0;
+        break;
+    case JournalEvent::Running:
+        state.pid = pid;
+        break;
+    case JournalEvent::Exited:
+    case JournalEvent::Failed:
+        state.pid = 0;
+        state.code = code;
+        break;
+    case JournalEvent::Terminated:
+        state.stopped = time;
+        state.pid = 0;
+        break;
+    }
+}
+
+static wstring journalFileName(const wchar_t *name, bool &ok)
+{
+    wstring fileName = dataPath(TEXT("journal"), ok);
+    fileName.append(name);
+    return fileName;
+}
+
+static wstring readName(const string &data, size_t &pos, DWORD length, bool &ok)
+{
+    ok = length<=MAX_NAME && pos + length * sizeof(wchar_t)<=data.size();
+    if (!ok)
+        return wstring();
+
+    wstring name(length, 0);
+    if (length)
+        memcpy(&name[0], data.data() + pos, length * sizeof(wchar_t));
+    pos += length * sizeof(wchar_t);
+    return name;
+}
+
+static void loadSnapshot(map<wstring, BoxState> &boxes, const string &data)
+{
+    SnapshotHeader header;
+    if (data.size()<sizeof(header))
+        return;
+
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic!=SNAPSHOT_MAGIC || header.version!=SNAPSHOT_VERSION ||
+            header.crc!=crc32(data.data() + sizeof(header), data.size() - sizeof(header)))
+        return;
+
+    size_t pos = sizeof(header);
+    for (DWORD idx = 0; idx<header.count && pos + sizeof(StateData)<=data.size(); idx++)
+    {
+        StateData stateData;
+        memcpy(&stateData, data.data() + pos, sizeof(stateData));
+        pos += sizeof(stateData);
+
+        bool ok;
+        BoxState state;
+        state.box = readName(data, pos, stateData.boxLength, ok);
+        if (ok)
+            state.account = readName(data, pos, stateData.accountLength, ok);
+        if (!ok)
+            break;
+
+        state.lastEvent = static_cast<JournalEvent>(stateData.lastEvent);
+        state.lastTime = stateData.lastTime;
+        state.cleared = stateData.cleared;
+        state.launched = stateData.launched;
+        state.stopped = stateData.stopped;
+        state.appId = stateData.appId;
+        state.pid = stateData.pid;
+        state.code = stateData.code;
+        boxes[boxKey(state.box)] = state;
+    }
+}
+
+static void loadLog(map<wstring, BoxState> &boxes, const string &data)
+{
+    size_t pos = 0;
+    while (pos + sizeof(RecordHeader) + sizeof(RecordData)<=data.size())
+    {
+        RecordHeader header;
+        memcpy(&header, data.data() + pos, sizeof(header));
+
+        bool valid = header.magic==RECORD_MAGIC && header.size>=sizeof(RecordData) &&
+                header.size<=data.size() - pos - sizeof(header) &&
+                header.crc==crc32(data.data() + pos + sizeof(header), header.size);
+        if (!valid)
+        {
+            /* torn write, look for the next record */
+            pos++;
+            continue;
+        }
+
+        size_t recordPos = pos + sizeof(header);
+        pos = recordPos + header.size;
+
+        RecordData record;
+        memcpy(&record, data.data() + recordPos, sizeof(record));
+        recordPos += sizeof(record);
+
+        bool ok;
+        wstring box = readName(data, recordPos, record.boxLength, ok);
+        wstring account = ok ? readName(data, recordPos, record.accountLength, ok) : wstring();
+        if (ok && !box.empty() && record.event<=static_cast<DWORD>(JournalEvent::Failed))
+            apply(boxes, static_cast<JournalEvent>(record.event), record.time, box, account, record.appId, record.pid, record.code);
+    }
+}
+
+/* Builds the index from the snapshot and whatever was logged after it */
+static void load(map<wstring, BoxState> &boxes, bool &ok, DWORD &errorCode)
+{
+    boxes.clear();
+
+    string data;
+    wstring snapshotName = journalFileName(TEXT("snapshot.bin"), ok);
+    wstring logName = journalFileName(TEXT("journal.log"), ok);
+    if (!ok)
+    {
+        errorCode = ERROR_PATH_NOT_FOUND;
+        return;
+    }
+
+    readFile(snapshotName, data, ok, errorCode);
+    if (ok)
+        loadSnapshot(boxes, data);
+
+    readFile(logName, data, ok, errorCode);
+    if (ok)
+        loadLog(boxes, data);
+
+    /* no journal yet is fine */
+    ok = true;
+    errorCode = 0;
+}
+
+void journalOpen(bool &ok, DWORD &errorCode)
+{
+    load(_boxes, ok, errorCode);
+
+    /* what this run did already is not written yet, but newer than the files */
+    loadLog(_boxes, _pending);
+}
+
+void journalAppend(JournalEvent event, const wstring &box, const wstring &account, DWORD appId, DWORD pid, DWORD code)
+{
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+
+    RecordData record;
+    ZeroMemory(&record, sizeof(record));
+    record.time = fileTimeValue(now);
+    record.appId = appId;
+    record.pid = pid;
+    record.code = code;
+    record.event = static_cast<DWORD>(event);
+    record.boxLength = static_cast<DWORD>(min(box.length(), static_cast<size_t>(MAX_NAME)));
+    record.accountLength = static_cast<DWORD>(min(account.length(), static_cast<size_t>(MAX_NAME)));
+
+    string payload(sizeof(record) + (record.boxLength + record.accountLength) * sizeof(wchar_t), 0);
+    memcpy(&payload[0], &record, sizeof(record));
+    memcpy(&payload[sizeof(record)], box.data(), record.boxLength * sizeof(wchar_t));
+    memcpy(&payload[sizeof(record) + record.boxLength * sizeof(wchar_t)], account.data(), record.accountLength * sizeof(wchar_t));
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.size = static_cast<DWORD>(payload.size());
+    header.crc = crc32(payload.data(), payload.size());
+    header.reserved = 0;
+
+    _pending.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    _pending.append(payload);
+
+    apply(_boxes, event, record.time, box, account, appId, pid, code);
+}
+
+static void compact(const wstring &snapshotName, const wstring &logName, bool &ok, DWORD &errorCode)
+{
+    map<wstring, BoxState> boxes;
+    load(boxes, ok, errorCode);
+
+    SnapshotHeader header;
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.count = static_cast<DWORD>(boxes.size());
+
+    string data(sizeof(header), 0);
+    for (const auto &entry : boxes)
+    {
+        const BoxState &state = entry.second;
+        StateData stateData;
+        ZeroMemory(&stateData, sizeof(stateData));
+        stateData.lastTime = state.lastTime;
+        stateData.cleared = state.cleared;
+        stateData.launched = state.launched;
+        stateData.stopped = state.stopped;
+        stateData.appId = state.appId;
+        stateData.pid = state.pid;
+        stateData.code = state.code;
+        stateData.lastEvent = static_cast<DWORD>(state.lastEvent);
+        stateData.boxLength = static_cast<DWORD>(state.box.length());
+        stateData.accountLength = static_cast<DWORD>(state.account.length());
+
+        data.append(reinterpret_cast<const char *>(&stateData), sizeof(stateData));
+        data.append(reinterpret_cast<const char *>(state.box.data()), state.box.length() * sizeof(wchar_t));
+        data.append(reinterpret_cast<const char *>(state.account.data()), state.account.length() * sizeof(wchar_t));
+    }
+    header.crc = crc32(data.data() + sizeof(header), data.size() - sizeof(header));
+    memcpy(&data[0], &header, sizeof(header));
+
+    /* if we die between these two the log is read again on top of the snapshot, which changes nothing */
+    writeFileAtomic(snapshotName, data, ok, errorCode);
+    if (!ok)
+        return;
+
+    HANDLE handle = CreateFileW(logName.data(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                TRUNCATE_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle==INVALID_HANDLE_VALUE)
+    {
+        ok = false;
+        errorCode = GetLastError();
+        return;
+    }
+    CloseHandle(handle);
+}
+
+/*
+ * Writes the events of this run in one go and flushes once. The log is
+ * shared by all instances, so appending and compacting happen under a
+ * machine wide mutex. That is held only for the write.
+ */
+void journalFlush(bool &ok, DWORD &errorCode)
+{
+    ok = true;
+    errorCode = 0;
+    if (_pending.empty())
+        return;
+
+    wstring snapshotName = journalFileName(TEXT("snapshot.bin"), ok);
+    wstring logName = journalFileName(TEXT("journal.log"), ok);
+    if (!ok)
+    {
+        errorCode = ERROR_PATH_NOT_FOUND;
+        return;
+    }
+
+    HANDLE mutex = CreateMutexW(nullptr, FALSE, TEXT("Global\\SandboxLauncher.Journal"));
+    if (!mutex)
+    {
+        ok = false;
+        errorCode = GetLastError();
+        return;
+    }
+
+    DWORD result = WaitForSingleObject(mutex, 10000);
+    if (result!=WAIT_OBJECT_0 && result!=WAIT_ABANDONED)
+    {
+        ok = false;
+        errorCode = result==WAIT_TIMEOUT ? ERROR_TIMEOUT : GetLastError();
+        CloseHandle(mutex);
+        return;
+    }
+
+    HANDLE handle = CreateFileW(logName.data(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+    size.QuadPart = 0;
+    if (handle!=INVALID_HANDLE_VALUE)
+    {
+        DWORD written = 0;
+        ok = WriteFile(handle, _pending.data(), static_cast<DWORD>(_pending.size()), &written, nullptr) && written==_pending.size();
+        if (ok)
+            ok = FlushFileBuffers(handle);
+        if (!ok)
+            errorCode = GetLastError();
+        GetFileSizeEx(handle, &size);
+        CloseHandle(handle);
+    } else {
+        ok = false;
+        errorCode = GetLastError();
+    }
+
+    if (ok)
+    {
+        _pending.clear();
+        if (size.QuadPart>JOURNAL_COMPACT_SIZE)
+            compact(snapshotName, logName, ok, errorCode);
+    }
+
+    ReleaseMutex(mutex);
+    CloseHandle(mutex);
+}
+
+bool journalLookup(const wstring &box, BoxState &state)
+{
+    auto found = _boxes.find(boxKey(box));
+    if (found==_boxes.end())
+        return false;
+
+    state = found->second;
+    return true;
+}
+
+/*
+ * Only with a pid (from /supervise) we can tell if Steam is still there. A plain
+ * launch has none, Start.exe is gone before Steam is up, so known is false then.
+ */
+bool journalAlive(const BoxState &state, bool &known)
+{
+    known = true;
+    if (state.lastEvent!=JournalEvent::Launched && state.lastEvent!=JournalEvent::Running)
+        return false;
+    if (state.pid==0)
+    {
+        known = false;
+        return false;
+    }
+
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, state.pid);
+    if (!process)
+        return false;
+
+    DWORD exitCode = 0;
+    bool alive = GetExitCodeProcess(process, &exitCode) && exitCode==STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+}
+
+static wstring formatTime(unsigned long long time)
+{
+    if (time==0)
+        return TEXT("-");
+
+    FILETIME fileTime;
+    fileTime.dwLowDateTime = static_cast<DWORD>(time);
+    fileTime.dwHighDateTime = static_cast<DWORD>(time >> 32);
+
+    SYSTEMTIME utc;
+    SYSTEMTIME local;
+    FileTimeToSystemTime(&fileTime, &utc);
+    SystemTimeToTzSpecificLocalTime(nullptr, &utc, &local);
+
+    wchar_t text[32];
+    swprintf(text, 32, L"%04u-%02u-%02u %02u:%02u", local.wYear, local.wMonth, local.wDay, local.wHour, local.wMinute);
+    return text;
+}
+
+void journalPrint(const wstring &box)
+{
+    consoleWrite(consolePad(TEXT("Sandbox"), 24) + consolePad(TEXT("State"), 12) + consolePad(TEXT("Since"), 18)
+                 + consolePad(TEXT("App"), 10) + consolePad(TEXT("Account"), 20) + TEXT("Cleared\n"));
+
+    wstring key = boxKey(box);
+    unsigned int shown = 0;
+    for (const auto &entry : _boxes)
+    {
+        if (!box.empty() && entry.first!=key)
+            continue;
+
+        const BoxState &state = entry.second;
+        wstring stateName = journalEventName(state.lastEvent);
+        bool known;
+        if (!journalAlive(state, known))
+        {
+            if (!known)
+                stateName = TEXT("unknown");
+            else if (state.lastEvent==JournalEvent::Launched || state.lastEvent==JournalEvent::Running)
+                stateName = TEXT("gone");
+        }
+
+        consoleWrite(consolePad(state.box, 24) + consolePad(stateName, 12) + consolePad(formatTime(state.lastTime), 18)
+                     + consolePad(state.appId ? to_wstring(state.appId) : wstring(TEXT("-")), 10)
+                     + consolePad(state.account.empty() ? wstring(TEXT("-")) : state.account, 20)
+                     + formatTime(state.cleared) + TEXT("\n"));
+        shown++;
+    }
+
+    if (shown==0)
+        consoleWrite(TEXT("Nothing known about ") + (box.empty() ? wstring(TEXT("any sandbox")) : box) + TEXT("\n"));
+}
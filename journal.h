@@ -0,0 +1,66 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/**************************************************************************
+    journal.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File journal.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Remembers what happened to every sandbox across runs. Each run appends its
+ * events to journal\journal.log in our data folder, all at once at the end
+ * with one flush to disk. Once the log gets big it is folded into
+ * journal\snapshot.bin and started over. Reading it back gives one BoxState
+ * per sandbox, so /status does not have to look at the boxes themselves.
+ */
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Fold the log into the snapshot once it is bigger than this */
+#define JOURNAL_COMPACT_SIZE (256 * 1024)
+
+enum class JournalEvent : unsigned char { Terminated = 0, Cleared = 1, Launched = 2, Running = 3, Exited = 4, Failed = 5 };
+
+struct BoxState
+{
+    wstring box;
+    JournalEvent lastEvent;
+    unsigned long long lastTime;
+    unsigned long long cleared;
+    unsigned long long launched;
+    unsigned long long stopped; /* last terminate or clear */
+    wstring account;
+    DWORD appId;
+    DWORD pid;
+    DWORD code;
+};
+
+const wchar_t *journalEventName(JournalEvent event);
+void journalOpen(bool &ok, DWORD &errorCode);
+void journalAppend(JournalEvent event, const wstring &box, const wstring &account = wstring(), DWORD appId = 0, DWORD pid = 0, DWORD code = 0);
+void journalFlush(bool &ok, DWORD &errorCode);
+bool journalLookup(const wstring &box, BoxState &state);
+bool journalAlive(const BoxState &state, bool &known);
+void journalPrint(const wstring &box);
+
+#endif // JOURNAL_H
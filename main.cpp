@@ -53,34 +53,75 @@
 
 #include <Windows.h>
 #include <algorithm>
-#include <set>
 #include <map>
+#include <vector>
 #include <wchar.h>
 #include <string>
-#include <iostream>
-#include <iomanip>
 #include "console.h"
+#include "boxlock.h"
+#include "steamlibrary.h"
+#include "sandboxieini.h"
+#include "trace.h"
+#include "storage.h"
+#include "stats.h"
+#include "prefetch.h"
+#include "supervise.h"
+#include "agent.h"
+#include "controller.h"
+#include "journal.h"
+#include "capture.h"
+#include "failure.h"
 
 using namespace std;
 
 /* SandboxieSteamLauncher Info */
-static wstring info(TEXT("Sandbox Launcher 1.0"));
-static wstring copyright(TEXT("Copyright (C) 2019 by Andreas Fischer."));
+static const wchar_t info[] = TEXT("Sandbox Launcher 1.0");
+static const wchar_t copyright[] = TEXT("Copyright (C) 2019 by Andreas Fischer.");
 
-/* Resonable (hopefully) defaults... */
-static wstring sandboxiePath(TEXT("C:\\Program Files\\Sandboxie-Plus\\"));
-static wstring sandboxieExe(TEXT("Start.exe"));
+/*
+ * Resonable (hopefully) defaults...
+ * We are started for every single launch, so anything that never changes is a plain
+ * array and everything else starts empty. That keeps the work before wmain close to nothing,
+ * the install paths only get their default in processArgs when no argument set them.
+ */
+static const wchar_t defaultSandboxiePath[] = TEXT("C:\\Program Files\\Sandboxie-Plus\\");
+static const wchar_t defaultSteamPath[] = TEXT("C:\\Program Files\\Steam\\");
+static wstring sandboxiePath;
+static const wchar_t sandboxieExe[] = TEXT("Start.exe");
 static wstring sandboxieBox(TEXT("Default"));
-static wstring steamPath(TEXT("C:\\Program Files\\Steam\\"));
-static wstring steamExe(TEXT("Steam.exe"));
-static wstring steamId(TEXT(""));
-static wstring steamUser(TEXT(""));
-static wstring steamPass(TEXT(""));
+static wstring sandboxieIni;
+static wstring steamPath;
+static const wchar_t steamExe[] = TEXT("Steam.exe");
+static wstring steamId;
+static wstring steamUser;
+static wstring steamPass;
+static wstring steamFind;
+
+/* Optional stuff, Sandboxie.ini changes, traces and stats */
+static wstring createBoxes;
+static wstring templateBox;
+static wstring setKeys;
+static wstring traceRecordFile;
+static wstring traceReplayFile;
+static wstring statsBox;
+static bool showStats = false;
+static wstring statusBox;
+static bool showStatus = false;
+static unsigned long long prefetchLimit = 0;
+static bool superviseBox = false;
+static bool logOutput = false;
+
+/* Remote launches, either we are an agent or the controller of some */
+static bool agentMode = false;
+static unsigned short agentPort = AGENT_DEFAULT_PORT;
+static unsigned int agentCapacity = AGENT_DEFAULT_CAPACITY;
+static wstring agentToken;
+static wstring controllerManifest;
+static wstring controllerAgents;
 
 /* Some statics to keep state */
-static wstring lastError = TEXT("");
-static wstring space = TEXT(" ");
-static wstring crlf = TEXT("\r\n");
+static const wchar_t space[] = TEXT(" ");
+static const wchar_t crlf[] = TEXT("\r\n");
 static int verboseOutput = 0;
 static bool console = false;
 static bool noexec = false;
@@ -88,9 +129,13 @@ static bool forceTerminate = false;
 static bool forceClear = false;
 static bool forceTest = false;
 static bool forceDialogs = false;
+static bool noDialogs = false;
+static bool noRetry = false;
+static DWORD lockTimeout = BOXLOCK_DEFAULT_TIMEOUT;
+static DWORD childExitCode = 0;
 
 /* Known arguments... checking the names to avoid problems due to typing errors etc */
-static set<wstring> knownArgs({
+static const wchar_t *knownArgs[] = {
                                     TEXT("sandboxie"),
                                     TEXT("box"),
                                     TEXT("steam"),
@@ -102,8 +147,38 @@ static set<wstring> knownArgs({
                                     TEXT("terminate"),
                                     TEXT("clear"),
                                     TEXT("test"),
-                                    TEXT("noexec")
-                                });
+                                    TEXT("noexec"),
+                                    TEXT("locktimeout"),
+                                    TEXT("find"),
+                                    TEXT("ini"),
+                                    TEXT("create"),
+                                    TEXT("template"),
+                                    TEXT("set"),
+                                    TEXT("record"),
+                                    TEXT("replay"),
+                                    TEXT("stats"),
+                                    TEXT("prefetch"),
+                                    TEXT("supervise"),
+                                    TEXT("agent"),
+                                    TEXT("capacity"),
+                                    TEXT("token"),
+                                    TEXT("controller"),
+                                    TEXT("agents"),
+                                    TEXT("status"),
+                                    TEXT("log"),
+                                    TEXT("noretry"),
+                                    TEXT("nodialogs")
+                                };
+
+/* Only used for verbose output, a few compares are cheaper than building a set on every start */
+bool isKnownArg(const wstring &name)
+{
+    for (const wchar_t *arg : knownArgs)
+        if (name==arg)
+            return true;
+
+    return false;
+}
 
 /* Well people need to know how to use it... */
 wstring helpText()
@@ -117,7 +192,7 @@ wstring helpText()
     text.append(crlf);
     text.append(TEXT("Arguments:\r\n\r\n"));
     text.append(TEXT("/box:sandbox\t\tThe name of the Sandbox to use.\t\t\t\t[Optional]\r\n"));
-    text.append(TEXT("/id:steam id\t\tThe Steam ID of the Application to launch.\t\t[Required]\r\n"));
+    text.append(TEXT("/id:steam id\t\tThe Steam ID or name of the Application to launch.\t[Required]\r\n"));
     text.append(TEXT("/user:username\t\tThe Steam Account name to use.\t\t\t\t[Optional]\r\n"));
     text.append(TEXT("/pass:password\t\tThe Steam Password. Requires /user to be set.\t\t[Optional]\r\n"));
     text.append(crlf);
@@ -125,11 +200,31 @@ wstring helpText()
     text.append(TEXT("Advanced Arguments:\r\n\r\n"));
     text.append(TEXT("/sandboxie:path\t\tThe installation path to Sandboxie.\t\t\t[Optional]\r\n"));
     text.append(TEXT("/steam:path\t\tThe installation path to Steam.\t\t\t\t[Optional]\r\n"));
+    text.append(TEXT("/find:name\t\tLists installed Steam apps matching the name.\t\t[Optional]\r\n"));
+    text.append(TEXT("/ini:path\t\tThe path to Sandboxie.ini.\t\t\t\t[Optional]\r\n"));
+    text.append(TEXT("/create:box,box\t\tCreates the sandboxes in Sandboxie.ini.\t\t\t[Optional]\r\n"));
+    text.append(TEXT("/template:box\t\tSandbox to copy the settings from for /create.\t\t[Optional]\r\n"));
+    text.append(TEXT("/set:key=value;...\tSets Sandboxie.ini keys for /box or /create boxes.\t[Optional]\r\n"));
     text.append(TEXT("/terminate\t\tTerminates an already running sandbox.\t\t\t[Optional]\r\n"));
     text.append(TEXT("/clear\t\t\tCleans up the sandbox before launching.\t\t\t[Optional]\r\n"));
     text.append(TEXT("/test\t\t\tPerforms a test run. Nothing is started.\t\t[Optional]\r\n"));
     text.append(TEXT("/noexec\t\t\tWill terminate or clear the sandbox. But not launch.\t[Optional]\r\n"));
+    text.append(TEXT("/locktimeout:seconds\tHow long to wait if the sandbox is busy. Default 120.\t[Optional]\r\n"));
+    text.append(TEXT("/noretry\t\tReports a failed Start.exe run without trying again.\t[Optional]\r\n"));
+    text.append(TEXT("/record:file\t\tRecords timing of everything started to a trace.\t[Optional]\r\n"));
+    text.append(TEXT("/replay:file\t\tStarts nothing, replays a recorded trace instead.\t[Optional]\r\n"));
+    text.append(TEXT("/prefetch[:MB]\t\tReads the game files into the cache. Default 1024 MB.\t[Optional]\r\n"));
+    text.append(TEXT("/supervise\t\tStays running and restarts Steam if it crashes.\t\t[Optional]\r\n"));
+    text.append(TEXT("/agent[:port]\t\tWaits for launches from a controller. Port 27900.\t[Optional]\r\n"));
+    text.append(TEXT("/capacity:number\tHow many launches the agent runs at once. Default 4.\t[Optional]\r\n"));
+    text.append(TEXT("/controller:file\tLaunches each line of the file on the /agents.\t\t[Optional]\r\n"));
+    text.append(TEXT("/agents:host:port,...\tThe agents for /controller.\t\t\t\t[Optional]\r\n"));
+    text.append(TEXT("/token:secret\t\tShared secret of agent and controller.\t\t\t[Optional]\r\n"));
+    text.append(TEXT("/log\t\t\tWrites the output of started programs to a log.\t\t[Optional]\r\n"));
+    text.append(TEXT("/stats[:box]\t\tShows this weeks launch times of all or one sandbox.\t[Optional]\r\n"));
+    text.append(TEXT("/status[:box]\t\tShows what was last done with all or one sandbox.\t[Optional]\r\n"));
     text.append(TEXT("/dialogs\t\tShows message dialogs even from command prompt.\t\t[Optional]\r\n"));
+    text.append(TEXT("/nodialogs\t\tNever shows message dialogs, for unattended runs.\t[Optional]\r\n"));
     text.append(TEXT("/verbose\t\tIt tells you what it is doing exactly.\t\t\t[Optional]\r\n"));
     text.append(crlf);
     text.append(crlf);
@@ -142,6 +237,8 @@ wstring helpText()
     text.append(TEXT("SandboxLauncher.exe /box:MyGameBox /id:12345 /user:johndoe /pass:password"));
     text.append(crlf);
     text.append(crlf);
+    text.append(TEXT("Exit codes: 0 done, 1 failed, 2 bad arguments, 3 something not found, 4 try again later\r\n"));
+    text.append(crlf);
 
     return text;
 }
@@ -179,19 +276,259 @@ wstring checkSteam(bool &ok)
     return check;
 }
 
-/* Execute our assembled command line... */
-void execute(const wstring &command, bool &ok, DWORD &errorCode, bool wait = false)
+/*
+ * Check if the app is installed in one of the steam libraries, so a typo fails here and not after
+ * starting a whole sandbox. A name instead of an id is resolved here too. Returns what went wrong.
+ */
+wstring checkSteamApp(bool &ok)
 {
     ok = true;
+    wstring msg;
+
+    if (steamId.empty())
+        return msg;
+
+    bool numeric = all_of(steamId.begin(), steamId.end(), [](wchar_t c) { return c>='0' && c<='9'; });
+    DWORD appId = numeric ? wcstoul(steamId.data(), nullptr, 10) : 0;
+
+    /* the normal case, the index knows the id already */
+    bool indexOk;
+    SteamApp app;
+    steamIndexOpen(steamPath, indexOk);
+    if (numeric && steamIndexLookup(appId, app))
+    {
+        if (verboseOutput)
+            consoleWrite(TEXT("Steam app ") + to_wstring(appId) + TEXT(" is ") + app.name + TEXT("\n"));
+        return msg;
+    }
+
+    /* new install, typo or a name... lets see what changed in the libraries */
+    DWORD errorCode;
+    unsigned int parsed;
+    steamIndexRefresh(steamPath, indexOk, errorCode, parsed);
+    if (verboseOutput)
+        consoleWrite(TEXT("Steam library index refreshed, ") + to_wstring(parsed) + TEXT(" manifests parsed\n"));
+
+    if (steamIndexEmpty())
+    {
+        if (verboseOutput)
+            consoleWrite(TEXT("No Steam libraries found, can not check the Steam ID\n"));
+        return msg;
+    }
+
+    if (numeric)
+    {
+        ok = steamIndexLookup(appId, app);
+        if (ok && verboseOutput)
+            consoleWrite(TEXT("Steam app ") + to_wstring(appId) + TEXT(" is ") + app.name + TEXT("\n"));
+        if (!ok)
+        {
+            msg.append(TEXT("There is no Steam app installed with the ID "));
+            msg.append(steamId);
+        }
+        return msg;
+    }
+
+    vector<SteamApp> apps = steamIndexFind(steamId);
+    if (apps.size()==1)
+    {
+        steamId = to_wstring(apps.front().appId);
+        if (verboseOutput)
+            consoleWrite(TEXT("Steam app ") + apps.front().name + TEXT(" has the ID ") + steamId + TEXT("\n"));
+        return msg;
+    }
+
+    ok = false;
+    if (apps.empty())
+    {
+        msg.append(TEXT("There is no Steam app installed matching "));
+        msg.append(steamId);
+    } else {
+        msg.append(TEXT("More than one Steam app matches "));
+        msg.append(steamId);
+        msg.append(TEXT(":\r\n"));
+        for (const SteamApp &match : apps)
+        {
+            msg.append(to_wstring(match.appId));
+            msg.append(TEXT("\t"));
+            msg.append(match.name);
+            msg.append(crlf);
+        }
+    }
+    return msg;
+}
+
+/*
+ * Starts reading the files of the app in the background. Runs while the sandbox
+ * is terminated and cleared, the launch waits a moment for it in waitPrefetch
+ * and the rest of the wait happens once the box lock is given back.
+ */
+void startPrefetch()
+{
+    SteamApp app;
+    bool numeric = !steamId.empty() && all_of(steamId.begin(), steamId.end(), [](wchar_t c) { return c>='0' && c<='9'; });
+    if (!numeric || !steamIndexLookup(wcstoul(steamId.data(), nullptr, 10), app))
+        return;
+
+    vector<wstring> files = prefetchFileList(app.appId, steamPath, app.installDir, prefetchLimit);
+    if (verboseOutput)
+        consoleWrite(TEXT("Prefetching ") + to_wstring(files.size()) + TEXT(" files of ") + app.name + TEXT("\n"));
+
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    prefetchStart(files, max(2u, static_cast<unsigned int>(systemInfo.dwNumberOfProcessors)));
+}
+
+bool waitPrefetch(DWORD timeout)
+{
+    unsigned long long bytes;
+    unsigned int files;
+    unsigned long long waited = microseconds();
+    bool finished = prefetchWait(timeout, bytes, files);
+    waited = microseconds() - waited;
+
+    if (verboseOutput)
+        consoleWrite((finished ? TEXT("Prefetched ") : TEXT("Prefetch still running, got ")) + to_wstring(files) + TEXT(" files, ") + to_wstring(bytes / (1024 * 1024)) + TEXT(" MB, waited ") + to_wstring(waited / 1000) + TEXT(" ms\n"));
+    return finished;
+}
+
+/* Splits a list argument like /create:a,b,c */
+vector<wstring> splitList(const wstring &text, wchar_t separator)
+{
+    vector<wstring> list;
+    size_t pos = 0;
+    while (pos<=text.length())
+    {
+        size_t end = text.find(separator, pos);
+        if (end==wstring::npos)
+            end = text.length();
+        if (end>pos)
+            list.push_back(text.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return list;
+}
+
+/*
+ * Creates the /create boxes and applies /set to them (or to /box) in one go,
+ * so a whole bunch of accounts costs one read and one write of Sandboxie.ini.
+ * Returns what went wrong, changed tells if Sandboxie has to reload.
+ */
+wstring provisionSandboxes(bool &ok, bool &changed)
+{
+    ok = true;
+    changed = false;
+    wstring msg;
+
+    vector<wstring> boxes = splitList(createBoxes, ',');
+    for (const wstring &box : boxes)
+    {
+        if (!iniValidBoxName(box))
+        {
+            ok = false;
+            msg.append(TEXT("Not a valid sandbox name (letters, digits and _ only): "));
+            msg.append(box);
+            return msg;
+        }
+
+        bool created;
+        iniCreateSection(box, templateBox, created);
+        if (!created && !iniHasSection(box))
+        {
+            ok = false;
+            msg.append(TEXT("The template sandbox does not exist: "));
+            msg.append(templateBox);
+            return msg;
+        }
+
+        if (verboseOutput)
+            consoleWrite((created ? TEXT("Created sandbox ") : TEXT("Sandbox already exists ")) + box + TEXT("\n"));
+    }
+
+    if (boxes.empty())
+        boxes.push_back(sandboxieBox);
+
+    vector<wstring> keys = splitList(setKeys, ';');
+    for (const wstring &keyValue : keys)
+    {
+        size_t idx = keyValue.find('=');
+        if (idx==wstring::npos || idx==0)
+        {
+            ok = false;
+            msg.append(TEXT("Expected key=value for /set but got: "));
+            msg.append(keyValue);
+            return msg;
+        }
+
+        for (const wstring &box : boxes)
+        {
+            if (!iniHasSection(box))
+            {
+                ok = false;
+                msg.append(TEXT("Sandbox does not exist in Sandboxie.ini: "));
+                msg.append(box);
+                return msg;
+            }
+
+            iniSetValue(box, keyValue.substr(0, idx), keyValue.substr(idx + 1));
+        }
+    }
+
+    changed = iniDirty();
+    if (!changed)
+        return msg;
+
     if (forceTest)
     {
         consoleAttribute(LIGHTRED);
-        wcout << "--- (Test Modus) would have executed the following:\r\n\t" << command << endl;
+        consoleWrite(TEXT("--- (Test Modus) would have written ") + sandboxieIni + TEXT("\r\n"));
+        return msg;
+    }
+
+    if (!iniClean())
+    {
+        ok = false;
+        msg.append(TEXT("Refusing to write "));
+        msg.append(sandboxieIni);
+        msg.append(TEXT(", it is not valid UTF-8 or UTF-16 and would be damaged"));
+        return msg;
+    }
+
+    DWORD errorCode;
+    iniSave(ok, errorCode);
+    if (!ok)
+    {
+        msg.append(TEXT("Could not write "));
+        msg.append(sandboxieIni);
+        msg.append(TEXT(" (Windows error "));
+        msg.append(to_wstring(errorCode));
+        msg.append(TEXT(")"));
+    }
+    return msg;
+}
+
+/* Execute our assembled command line... */
+void execute(LaunchPhase phase, const wstring &command, bool &ok, DWORD &errorCode, bool wait = false)
+{
+    ok = true;
+    DWORD exitCode = 0;
+    unsigned long long duration;
+
+    if (traceReplaying())
+    {
+        traceReplay(phase, ok, errorCode, exitCode, duration);
+        childExitCode = exitCode;
+        if (verboseOutput)
+            consoleWrite(wstring(TEXT("--- (Replay) ")) + phaseName(phase) + TEXT(" took ") + to_wstring(duration / 1000) + TEXT(" ms with exit code ") + to_wstring(exitCode) + TEXT("\n"));
         return;
     }
 
-    STARTUPINFOW si;
-    PROCESS_INFORMATION pi;
+    if (forceTest)
+    {
+        consoleAttribute(LIGHTRED);
+        consoleWrite(TEXT("--- (Test Modus) would have executed the following:\r\n\t") + command + TEXT("\r\n"));
+        return;
+    }
 
     /*
      * we can do that because CreateProcessW is doing nothing to the data
@@ -199,30 +536,123 @@ void execute(const wstring &command, bool &ok, DWORD &errorCode, bool wait = fal
     */
     wchar_t* cmd = const_cast<wchar_t*>(command.data());
 
-    ZeroMemory( &si, sizeof(si) );
-    si.cb = sizeof(si);
-    ZeroMemory( &pi, sizeof(pi) );
-
-    ok = CreateProcessW( nullptr,
-                                   cmd,
-                                   nullptr,
-                                   nullptr,
-                                   FALSE,
-                                   0,
-                                   nullptr,
-                                   nullptr,
-                                   &si,
-                                   &pi
-                                   );
+    FILETIME startTime;
+    GetSystemTimeAsFileTime(&startTime);
+    unsigned long long started = microseconds();
 
-    if (ok==false)
-        errorCode = GetLastError();
-    else if (wait)
-        WaitForSingleObject(pi.hProcess, INFINITE );
+    /* with /log the output goes to logs\<box>.log, if we can't have that it goes to the console as always */
+    wstring logName;
+    if (logOutput)
+    {
+        logName = dataPath(TEXT("logs"), ok);
+        logName.append(sandboxieBox);
+        logName.append(TEXT(".log"));
+        if (!ok)
+            logName.clear();
+    }
+
+    /* transient failures get a few more tries, permanent ones are reported right away */
+    unsigned long long attemptStarted = started;
+    for (unsigned int attempt = 1; ; attempt++)
+    {
+        attemptStarted = microseconds();
+        STARTUPINFOW si;
+        PROCESS_INFORMATION pi;
+
+        ZeroMemory( &si, sizeof(si) );
+        si.cb = sizeof(si);
+        ZeroMemory( &pi, sizeof(pi) );
+
+        errorCode = 0;
+        exitCode = 0;
+        Failure failure = Failure::None;
+
+        /* no log is no reason to fail the launch, then it just runs without */
+        bool captured = false;
+        if (!logName.empty())
+        {
+            captureProcess(command, logName, phaseName(phase), pi, captured, ok, errorCode);
+            if (!captured && verboseOutput)
+                consoleWrite(wstring(TEXT("Could not capture the output of ")) + phaseName(phase) + TEXT(", Windows error ") + to_wstring(errorCode) + TEXT("\n"));
+        }
+
+        if (!captured)
+            ok = CreateProcessW( nullptr,
+                                       cmd,
+                                       nullptr,
+                                       nullptr,
+                                       FALSE,
+                                       0,
+                                       nullptr,
+                                       nullptr,
+                                       &si,
+                                       &pi
+                                       );
+
+        if (ok==false)
+        {
+            if (!captured)
+                errorCode = GetLastError();
+            failure = classifyError(errorCode);
+        }
+        else if (wait)
+        {
+            if (WaitForSingleObject(pi.hProcess, EXECUTE_TIMEOUT)==WAIT_TIMEOUT)
+            {
+                ok = false;
+                errorCode = ERROR_TIMEOUT;
+                failure = Failure::Transient;
+            } else {
+                GetExitCodeProcess(pi.hProcess, &exitCode);
+                if (captured)
+                    captureWait(CAPTURE_DRAIN_TIMEOUT);
+
+                /* only the launch has to work out, terminate or clear of an empty box may complain. A crash counts everywhere */
+                failure = classifyExitCode(exitCode);
+                if (phase!=LaunchPhase::Launch && failure==Failure::Permanent)
+                    failure = Failure::None;
+                ok = failure==Failure::None;
+            }
+        }
+
+        CloseHandle( pi.hProcess );
+        CloseHandle( pi.hThread );
+
+        /* a Start.exe that timed out is still running, starting another one would not help */
+        if (failure!=Failure::Transient || errorCode==ERROR_TIMEOUT || noRetry || attempt>FAILURE_RETRIES)
+            break;
 
+        DWORD delay = retryDelay(attempt);
+        if (verboseOutput)
+            consoleWrite(wstring(phaseName(phase)) + TEXT(" failed, trying again in ") + to_wstring(delay) + TEXT(" ms\n"));
+        Sleep(delay);
+    }
 
-    CloseHandle( pi.hProcess );
-    CloseHandle( pi.hThread );
+    childExitCode = exitCode;
+
+    /* the trace keeps the whole time for replay, the stats only the attempt that counted and not our retry sleeps */
+    unsigned long long now = microseconds();
+    duration = now - started;
+    traceRecord(phase, ok, wait, ok ? 0 : errorCode, exitCode, fileTimeValue(startTime), duration);
+    if (ok)
+        statsRecord(statsPhase(phase), now - attemptStarted);
+
+    /* remember what happened to the box, written at the end of the run */
+    if (phase!=LaunchPhase::Reload)
+    {
+        JournalEvent event = JournalEvent::Failed;
+        if (ok)
+            event = phase==LaunchPhase::Terminate ? JournalEvent::Terminated :
+                    phase==LaunchPhase::Clear ? JournalEvent::Cleared : JournalEvent::Launched;
+        journalAppend(event, sandboxieBox, steamUser, wcstoul(steamId.data(), nullptr, 10), 0, errorCode ? errorCode : exitCode);
+    }
+}
+
+/* Digits only and not too many of them, for the number arguments */
+bool isNumber(const wstring &value, size_t maxDigits)
+{
+    return !value.empty() && value.length()<=maxDigits
+            && all_of(value.begin(), value.end(), [](wchar_t c) { return c>='0' && c<='9'; });
 }
 
 /* Check if a wstring ends with another wstring. Used to complete paths */
@@ -236,16 +666,22 @@ bool hasEnding (wstring const &str, wchar_t const &ending) {
         return false;
 }
 
-void showMessage(const wchar_t *title, const wchar_t *msg, unsigned int option = 0, bool shouldExit = true)
+void showMessage(const wchar_t *title, const wchar_t *msg, unsigned int option = 0, bool shouldExit = true,
+                 int exitCode = LAUNCH_EXIT_FAILED)
 {
     unsigned int opt = MB_OK;
     if (option!=0)
         opt = opt | option;
 
-    if (console==true)
+    /* with /nodialogs nobody is there to click a dialog away, the exit code has to do */
+    if (console==true || noDialogs)
     {
-         wcout << title << endl << endl << msg << endl;
-         if (forceDialogs)
+         wstring text(title);
+         text.append(TEXT("\r\n\r\n"));
+         text.append(msg);
+         text.append(TEXT("\r\n"));
+         consoleWrite(text);
+         if (forceDialogs && !noDialogs)
             MessageBoxW(nullptr, msg, title, opt);
     } else {
         MessageBoxW(nullptr, msg, title, opt);
@@ -253,8 +689,13 @@ void showMessage(const wchar_t *title, const wchar_t *msg, unsigned int option =
 
     if (shouldExit)
     {
+        bool ok;
+        DWORD errorCode;
+        journalFlush(ok, errorCode);
+        boxUnlock(); /* Let the next launch of this box go ahead...*/
+        traceRecordClose();
         consoleReset(); /* We are done reset the console...*/
-        exit(0);
+        exit(exitCode);
     }
 }
 
@@ -264,10 +705,10 @@ void showArgsHelp(bool shouldExit = true)
     wchar_t title[] = TEXT("Sandbox Launcher: Arguments Help");
     wstring msg = helpText();
 
-    showMessage(title, msg.data() , MB_ICONINFORMATION, shouldExit);
+    showMessage(title, msg.data() , MB_ICONINFORMATION, shouldExit, LAUNCH_EXIT_USAGE);
 }
 
-void showWindowsError(DWORD errorCode, bool shouldExit = true)
+void showWindowsError(DWORD errorCode, bool shouldExit, int exitCode)
 {
     if (errorCode!=0)
     {
@@ -278,12 +719,37 @@ void showWindowsError(DWORD errorCode, bool shouldExit = true)
                             nullptr, errorCode, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPWSTR)&msg, 0, nullptr);
 
 
-        showMessage(title, msg, MB_ICONERROR, shouldExit);
+        showMessage(title, msg, MB_ICONERROR, shouldExit, exitCode);
 
         LocalFree(msg);
     }
 }
 
+void showWindowsError(DWORD errorCode, bool shouldExit = true)
+{
+    showWindowsError(errorCode, shouldExit, errorExitCode(errorCode));
+}
+
+/* After execute, either Windows did not let us or Start.exe ended with an error */
+void showExecuteError(LaunchPhase phase, DWORD errorCode, bool shouldExit = true)
+{
+    if (errorCode!=0)
+    {
+        showWindowsError(errorCode, shouldExit);
+        return;
+    }
+
+    wchar_t code[16];
+    swprintf(code, 16, L"0x%08X", childExitCode);
+
+    wstring msg = TEXT("Start.exe failed to ");
+    msg.append(phaseName(phase));
+    msg.append(TEXT(" the sandbox with exit code "));
+    msg.append(code);
+    showMessage(TEXT("SandboxieStreamLauncher: Sandboxie failed!"), msg.data(), MB_ICONERROR, shouldExit,
+                failureExitCode(classifyExitCode(childExitCode)));
+}
+
 /* parse the command line and create a map of arguments. arguments that have no : suffix will be set to true if present. */
 map<wstring,wstring> parseArgs( int argc, wchar_t** argv, bool &ok)
 {
@@ -315,23 +781,26 @@ map<wstring,wstring> parseArgs( int argc, wchar_t** argv, bool &ok)
                 argName = key;
                 argValue = TEXT("true");
 
-                /* we evaluate those two early because they influence output */
+                /* we evaluate those early because they influence output */
                 if (key==TEXT("dialogs"))
                     forceDialogs = true;
 
+                if (key==TEXT("nodialogs"))
+                    noDialogs = true;
+
                 if (key==TEXT("verbose"))
                     verboseOutput = true;
             }
 
             /* we got an argument we know nothing about... */
-            if (!knownArgs.count(argName) && verboseOutput)
+            if (verboseOutput && !isKnownArg(argName))
             {
-                wcout << "Unknown argument " << argName << " with value " << argValue << endl;
+                consoleWrite(TEXT("Unknown argument ") + argName + TEXT(" with value ") + argValue + TEXT("\n"));
             }
 
         } else {
             if (verboseOutput)
-                wcout << "Something went wrong processing " << arg << ". Missing argument prefix /?" << endl;
+                consoleWrite(TEXT("Something went wrong processing ") + arg + TEXT(". Missing argument prefix /?\n"));
             ok = false;
         }
     }
@@ -352,7 +821,7 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
     {
         forceTest = true;
         if (verboseOutput)
-            wcout << "--- (Test Modus) nothing will be executed!" << endl;
+            consoleWrite(TEXT("--- (Test Modus) nothing will be executed!\n"));
     }
 
     consoleAttribute(LIGHTMAGENTA);
@@ -364,8 +833,10 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
             sandboxiePath.append(TEXT("\\"));
 
         if (verboseOutput)
-            wcout << "Sandboxie path is set to: " << sandboxiePath << endl;
+            consoleWrite(TEXT("Sandboxie path is set to: ") + sandboxiePath + TEXT("\n"));
 
+    } else {
+        sandboxiePath = defaultSandboxiePath;
     }
 
     if (argMap.count(TEXT("box"))!=0)
@@ -373,7 +844,39 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
         sandboxieBox = argMap.at(TEXT("box"));
 
         if (verboseOutput)
-            wcout << "Sandbox is set to: " << sandboxieBox << endl;
+            consoleWrite(TEXT("Sandbox is set to: ") + sandboxieBox + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("ini"))!=0)
+    {
+        sandboxieIni = argMap.at(TEXT("ini"));
+
+        if (verboseOutput)
+            consoleWrite(TEXT("Sandboxie.ini is set to: ") + sandboxieIni + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("create"))!=0)
+    {
+        createBoxes = argMap.at(TEXT("create"));
+
+        if (verboseOutput)
+            consoleWrite(TEXT("Will create the sandboxes: ") + createBoxes + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("template"))!=0)
+    {
+        templateBox = argMap.at(TEXT("template"));
+
+        if (verboseOutput)
+            consoleWrite(TEXT("New sandboxes are based on: ") + templateBox + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("set"))!=0)
+    {
+        setKeys = argMap.at(TEXT("set"));
+
+        if (verboseOutput)
+            consoleWrite(TEXT("Will set in Sandboxie.ini: ") + setKeys + TEXT("\n"));
     }
 
 
@@ -385,7 +888,9 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
             steamPath.append(TEXT("\\"));
 
         if (verboseOutput)
-            wcout << "Steam path is set to: " << steamPath << endl;
+            consoleWrite(TEXT("Steam path is set to: ") + steamPath + TEXT("\n"));
+    } else {
+        steamPath = defaultSteamPath;
     }
 
     if (argMap.count(TEXT("id"))!=0)
@@ -393,7 +898,15 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
         steamId = argMap.at(TEXT("id"));
 
         if (verboseOutput)
-            wcout << "Steam ID is set to: " << steamId << endl;
+            consoleWrite(TEXT("Steam ID is set to: ") + steamId + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("find"))!=0)
+    {
+        steamFind = argMap.at(TEXT("find"));
+
+        if (verboseOutput)
+            consoleWrite(TEXT("Searching Steam apps for: ") + steamFind + TEXT("\n"));
     }
 
     if (argMap.count(TEXT("user"))!=0)
@@ -401,7 +914,7 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
         steamUser = argMap.at(TEXT("user"));
 
         if (verboseOutput)
-            wcout << "Steam User is set to: " << steamUser << endl;
+            consoleWrite(TEXT("Steam User is set to: ") + steamUser + TEXT("\n"));
     }
 
     if (argMap.count(TEXT("pass"))!=0)
@@ -409,7 +922,7 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
         steamPass = argMap.at(TEXT("pass"));
 
         if (verboseOutput)
-            wcout << "Steam Password is set: " << steamPass << endl;
+            consoleWrite(TEXT("Steam Password is set: ") + steamPass + TEXT("\n"));
     }
 
 
@@ -418,27 +931,165 @@ void processArgs(const map<wstring,wstring> &argMap, bool &ok)
     {
         forceTerminate = true;
         if (verboseOutput)
-            wcout << "Will force a sandbox termination for " << sandboxieBox << endl;
+            consoleWrite(TEXT("Will force a sandbox termination for ") + sandboxieBox + TEXT("\n"));
     }
 
     if (argMap.count(TEXT("clear"))!=0)
     {
         forceClear = true;
         if (verboseOutput)
-            wcout << "Will force a sandbox cleanup for " << sandboxieBox << endl;
+            consoleWrite(TEXT("Will force a sandbox cleanup for ") + sandboxieBox + TEXT("\n"));
     }
 
     if (argMap.count(TEXT("noexec"))!=0)
     {
         noexec = true;
         if (verboseOutput)
-            wcout << "Will not launch Steam. Only sandbox termination and cleaning..." << endl;
+            consoleWrite(TEXT("Will not launch Steam. Only sandbox termination and cleaning...\n"));
+    }
+
+    if (argMap.count(TEXT("noretry"))!=0)
+    {
+        noRetry = true;
+        if (verboseOutput)
+            consoleWrite(TEXT("Will not retry failed Start.exe runs\n"));
+    }
+
+    if (argMap.count(TEXT("record"))!=0)
+    {
+        traceRecordFile = argMap.at(TEXT("record"));
+        if (verboseOutput)
+            consoleWrite(TEXT("Will record a launch trace to ") + traceRecordFile + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("replay"))!=0)
+    {
+        traceReplayFile = argMap.at(TEXT("replay"));
+        if (verboseOutput)
+            consoleWrite(TEXT("Will replay the launch trace ") + traceReplayFile + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("stats"))!=0)
+    {
+        showStats = true;
+        if (argMap.at(TEXT("stats"))!=TEXT("true"))
+            statsBox = argMap.at(TEXT("stats"));
+    }
+
+    if (argMap.count(TEXT("status"))!=0)
+    {
+        showStatus = true;
+        if (argMap.at(TEXT("status"))!=TEXT("true"))
+            statusBox = argMap.at(TEXT("status"));
+    }
+
+    if (argMap.count(TEXT("log"))!=0)
+    {
+        logOutput = true;
+        if (verboseOutput)
+            consoleWrite(TEXT("Output of started programs goes to logs\\") + sandboxieBox + TEXT(".log\n"));
+    }
+
+    if (argMap.count(TEXT("prefetch"))!=0)
+    {
+        /* MB, digits only, 9 of them can not overflow once turned into bytes */
+        const wstring &value = argMap.at(TEXT("prefetch"));
+        prefetchLimit = PREFETCH_DEFAULT_LIMIT;
+        if (value!=TEXT("true"))
+        {
+            if (!isNumber(value, 9))
+            {
+                ok = false;
+                return;
+            }
+            prefetchLimit = wcstoull(value.data(), nullptr, 10) * 1024 * 1024;
+        }
+        if (verboseOutput)
+            consoleWrite(TEXT("Will prefetch up to ") + to_wstring(prefetchLimit / (1024 * 1024)) + TEXT(" MB of game files\n"));
+    }
+
+    if (argMap.count(TEXT("supervise"))!=0)
+    {
+        superviseBox = true;
+        if (verboseOutput)
+            consoleWrite(TEXT("Will keep Steam running in the sandbox\n"));
+    }
+
+    if (argMap.count(TEXT("agent"))!=0)
+    {
+        agentMode = true;
+        if (argMap.at(TEXT("agent"))!=TEXT("true"))
+        {
+            const wstring &value = argMap.at(TEXT("agent"));
+            unsigned long port = isNumber(value, 5) ? wcstoul(value.data(), nullptr, 10) : 0;
+            if (port==0 || port>65535)
+            {
+                ok = false;
+                return;
+            }
+            agentPort = static_cast<unsigned short>(port);
+        }
+
+        if (argMap.count(TEXT("capacity"))!=0)
+        {
+            const wstring &value = argMap.at(TEXT("capacity"));
+            unsigned long capacity = isNumber(value, 4) ? wcstoul(value.data(), nullptr, 10) : 0;
+            if (capacity==0)
+            {
+                ok = false;
+                return;
+            }
+            agentCapacity = static_cast<unsigned int>(capacity);
+        }
+    }
+
+    if (argMap.count(TEXT("controller"))!=0)
+    {
+        controllerManifest = argMap.at(TEXT("controller"));
+        if (argMap.count(TEXT("agents"))==0)
+        {
+            ok = false;
+            return;
+        }
+        controllerAgents = argMap.at(TEXT("agents"));
+        if (verboseOutput)
+            consoleWrite(TEXT("Will launch ") + controllerManifest + TEXT(" on ") + controllerAgents + TEXT("\n"));
+    }
+
+    if (argMap.count(TEXT("token"))!=0)
+        agentToken = argMap.at(TEXT("token"));
+
+    if (argMap.count(TEXT("locktimeout"))!=0)
+    {
+        /* seconds, digits only, and kept well below INFINITE */
+        const wstring &value = argMap.at(TEXT("locktimeout"));
+        if (!isNumber(value, 9))
+        {
+            ok = false;
+            return;
+        }
+        lockTimeout = static_cast<DWORD>(min(wcstoul(value.data(), nullptr, 10), static_cast<unsigned long>(BOXLOCK_MAX_TIMEOUT / 1000))) * 1000;
+        if (verboseOutput)
+            consoleWrite(TEXT("Will wait ") + to_wstring(lockTimeout / 1000) + TEXT(" seconds if the sandbox is busy\n"));
     }
 
     consoleReset();
     ok = true;
 }
 
+wstring buildReloadCommandLine(bool &ok)
+{
+    wstring commandLine;
+
+    commandLine.append(sandboxiePath);
+    commandLine.append(sandboxieExe);
+    commandLine.append(TEXT(" /reload"));
+
+    ok = true;
+
+    return commandLine;
+}
+
 wstring buildTerminateCommandLine(bool &ok)
 {
     wstring commandLine;
@@ -481,7 +1132,7 @@ wstring buildLaunchCommandLine(bool &ok)
         ok = false;
 
         if (verboseOutput)
-            wcout << "Error: We got no Steam ID!" << endl;
+            consoleWrite(TEXT("Error: We got no Steam ID!\n"));
     }
 
     /* Sanity check... we can not have a password but no user... */
@@ -490,7 +1141,7 @@ wstring buildLaunchCommandLine(bool &ok)
         ok = false;
 
         if (verboseOutput)
-            wcout << "Error: We got a Steam Password but no Steam User!" << endl;
+            consoleWrite(TEXT("Error: We got a Steam Password but no Steam User!\n"));
     }
 
     if (ok==false)
@@ -523,26 +1174,37 @@ wstring buildLaunchCommandLine(bool &ok)
     return commandLine;
 }
 
-/* checks if we got launched from the command prompt or by a double click */
-bool launchedFromConsole() {
-    HWND consoleWnd = GetConsoleWindow();
-    DWORD dwProcessId;
+/* Used by /supervise, cleans up what is left of the crashed Steam and launches again */
+void relaunch(bool &ok, DWORD &errorCode)
+{
+    wstring commandLine = buildTerminateCommandLine(ok);
+    if (ok)
+        execute(LaunchPhase::Terminate, commandLine, ok, errorCode, true);
 
-    GetWindowThreadProcessId(consoleWnd, &dwProcessId);
+    commandLine = buildLaunchCommandLine(ok);
+    if (ok)
+        execute(LaunchPhase::Launch, commandLine, ok, errorCode, true);
+}
 
-    if (GetCurrentProcessId()==dwProcessId)
-        return false;
-    else
-        return true;
+/*
+ * checks if we got launched from the command prompt or by a double click.
+ * If we are the only process on the console nobody else opened it. This stays
+ * in kernel32, asking the console window for its process would load user32.
+ */
+bool launchedFromConsole() {
+    DWORD processList[2];
+
+    return GetConsoleProcessList(processList, 2)>1;
 }
 
 /*
  * Our entry point. we use wmain because sandboxie is only available on windows so no need to be portable.
  * Also who knows there might be Russian or Chinese people interested in it, so we use all unicode :)
  */
-void wmain( int argc, wchar_t** argv)
+int wmain( int argc, wchar_t** argv)
 {
     //const Console *consolex = Console::instance();
+    unsigned long long started = microseconds();
 
     consoleInit(); /* first we save the console state so we dont mess it up...*/
 
@@ -551,7 +1213,14 @@ void wmain( int argc, wchar_t** argv)
     if (argc==1)
         showArgsHelp();
     else
-        wcout << endl << "\t\t" << info << endl << "\t\t" << copyright << endl << endl;
+    {
+        wstring banner(TEXT("\r\n\t\t"));
+        banner.append(info);
+        banner.append(TEXT("\r\n\t\t"));
+        banner.append(copyright);
+        banner.append(TEXT("\r\n\r\n"));
+        consoleWrite(banner);
+    }
     consoleReset();
 
     bool ok; /* used throughout wmain to check if stuff blew up */
@@ -570,49 +1239,223 @@ void wmain( int argc, wchar_t** argv)
     processArgs(argMap, ok);
     if (!ok) showArgsHelp();
 
-    /* Check if we got sandboxie */
+    /* Tracing... replay means we start nothing ourself */
+    if (!traceReplayFile.empty())
+    {
+        size_t count;
+        traceReplayOpen(traceReplayFile, sandboxieBox, ok, errorCode, count);
+        if (!ok) showWindowsError(errorCode);
+
+        if (verboseOutput)
+            consoleWrite(TEXT("Replaying ") + to_wstring(count) + TEXT(" recorded processes for ") + sandboxieBox + TEXT("\n"));
+    } else if (!traceRecordFile.empty()) {
+        traceRecordOpen(traceRecordFile, sandboxieBox, ok, errorCode);
+        if (!ok) showWindowsError(errorCode);
+    }
+
+    /* Only looking at the numbers? */
+    if (showStats)
+    {
+        statsPrint(statsBox);
+
+        consoleReset();
+        return LAUNCH_EXIT_OK;
+    }
+
+    if (showStatus)
+    {
+        journalOpen(ok, errorCode);
+        if (!ok) showWindowsError(errorCode);
+        journalPrint(statusBox);
+
+        consoleReset();
+        return LAUNCH_EXIT_OK;
+    }
+
+    /* Remote launches, an agent serves until it is closed */
+    if (agentMode)
+    {
+        /* remote launches can not choose paths, they get the ones we were started with */
+        vector<wstring> localArgs;
+        for (const wchar_t *name : { TEXT("sandboxie"), TEXT("steam"), TEXT("ini") })
+            if (argMap.count(name)!=0)
+                localArgs.push_back(TEXT("/") + wstring(name) + TEXT(":") + argMap.at(name));
+
+        agentRun(agentPort, agentToken, agentCapacity, localArgs, ok, errorCode);
+        if (!ok) showWindowsError(errorCode);
+
+        consoleReset();
+        return LAUNCH_EXIT_OK;
+    }
+
+    if (!controllerManifest.empty())
+    {
+        int exitCode;
+        controllerRun(controllerManifest, splitList(controllerAgents, ','), agentToken, ok, errorCode, exitCode);
+        if (!ok && errorCode!=0) showWindowsError(errorCode, true, exitCode);
+        if (!ok)
+        {
+            wstring msg = TEXT("Not all launches of the manifest were done:\r\n");
+            msg.append(controllerManifest);
+            showMessage(TEXT("SandboxieStreamLauncher: Launches failed!"), msg.data(), MB_ICONERROR, true, exitCode);
+        }
+
+        consoleReset();
+        return LAUNCH_EXIT_OK;
+    }
+
+    /* Only looking for an app? */
+    if (!steamFind.empty())
+    {
+        unsigned int parsed;
+        steamIndexRefresh(steamPath, ok, errorCode, parsed);
+        vector<SteamApp> apps = steamIndexFind(steamFind);
+        for (const SteamApp &app : apps)
+        {
+            wstring line = to_wstring(app.appId);
+            if (line.length()<10)
+                line.insert(0, 10 - line.length(), ' ');
+            consoleWrite(line + TEXT("\t") + app.name + TEXT("\r\n"));
+        }
+        if (apps.empty())
+            consoleWrite(TEXT("No installed Steam app matches ") + steamFind + TEXT("\r\n"));
+
+        consoleReset();
+        return LAUNCH_EXIT_OK;
+    }
+
+    /* Check if we got sandboxie, a replay runs without it */
     wstring path = checkSandboxie(ok);
-    if (!ok)
+    if (!ok && !traceReplaying())
     {
         wstring msg = TEXT("Sandboxie could not be found at the given path:\r\n");
         msg.append(path);
-        showMessage(TEXT("SandboxieStreamLauncher: Sandboxie not found!"),msg.data(), MB_ICONERROR);
+        showMessage(TEXT("SandboxieStreamLauncher: Sandboxie not found!"),msg.data(), MB_ICONERROR, true, LAUNCH_EXIT_NOT_FOUND);
     }
 
+    /* Sandboxie.ini, only needed to check the box or to change it... */
+    if (sandboxieIni.empty())
+        sandboxieIni = iniDefaultPath(sandboxiePath);
+
+    if ((!createBoxes.empty() || !setKeys.empty()) && !traceReplaying())
+    {
+        /* ini changes have to be ordered just like box launches, the name can not clash with a box */
+        bool abandoned;
+        boxLock(TEXT("Sandboxie.ini"), lockTimeout, ok, abandoned, errorCode);
+        if (!ok) showWindowsError(errorCode);
+
+        iniLoad(sandboxieIni, ok, errorCode);
+        if (!ok)
+        {
+            wstring msg = TEXT("Sandboxie.ini could not be read:\r\n");
+            msg.append(sandboxieIni);
+            showMessage(TEXT("SandboxieStreamLauncher: Sandboxie.ini not found!"), msg.data(), MB_ICONERROR, true, LAUNCH_EXIT_NOT_FOUND);
+        }
+
+        bool changed;
+        wstring msg = provisionSandboxes(ok, changed);
+        boxUnlock();
+        if (!ok)
+            showMessage(TEXT("SandboxieStreamLauncher: Sandboxie.ini not changed!"), msg.data(), MB_ICONERROR);
+
+        if (changed)
+        {
+            consoleAttribute(WHITE);
+            if (verboseOutput)
+                consoleWrite(TEXT("Reloading Sandboxie configuration\n"));
+
+            commandLine = buildReloadCommandLine(ok);
+            execute(LaunchPhase::Reload, commandLine, ok, errorCode, true);
+            if (!ok) showExecuteError(LaunchPhase::Reload, errorCode);
+        }
+    } else if ((forceTerminate || forceClear || !noexec) && !traceReplaying()) {
+        iniLoad(sandboxieIni, ok, errorCode);
+        if (!ok && verboseOutput)
+            consoleWrite(TEXT("Sandboxie.ini could not be read, can not check the sandbox\n"));
+    }
+
+    if (iniLoaded() && (forceTerminate || forceClear || !noexec) && !iniHasSection(sandboxieBox))
+    {
+        wstring msg = TEXT("The sandbox does not exist in Sandboxie.ini:\r\n");
+        msg.append(sandboxieBox);
+        showMessage(TEXT("SandboxieStreamLauncher: Sandbox not found!"), msg.data(), MB_ICONERROR, true, LAUNCH_EXIT_NOT_FOUND);
+    }
+
+    /* Check if the app is installed before we touch the sandbox */
+    if (!noexec && !traceReplaying())
+    {
+        wstring msg = checkSteamApp(ok);
+        if (!ok)
+            showMessage(TEXT("SandboxieStreamLauncher: Steam app not found!"), msg.data(), MB_ICONERROR, true, LAUNCH_EXIT_NOT_FOUND);
+    }
+
+    /*
+     * Terminate, clear and launch of one box must not interleave with another
+     * instance doing the same box. Other boxes are not affected by this lock.
+     */
+    bool abandoned;
+    unsigned long long lockWait = microseconds();
+    boxLock(sandboxieBox, lockTimeout, ok, abandoned, errorCode);
+    lockWait = microseconds() - lockWait;
+    if (!ok)
+    {
+        if (errorCode==ERROR_TIMEOUT)
+        {
+            wstring msg = TEXT("Sandbox is busy with another launch:\r\n");
+            msg.append(sandboxieBox);
+            showMessage(TEXT("SandboxieStreamLauncher: Sandbox busy!"), msg.data(), MB_ICONERROR, true, LAUNCH_EXIT_RETRY);
+        }
+        showWindowsError(errorCode);
+    }
+
+    if (abandoned && verboseOutput)
+    {
+        consoleAttribute(LIGHTRED);
+        consoleWrite(TEXT("Previous launch of ") + sandboxieBox + TEXT(" died while holding the sandbox. Continuing...\n"));
+    }
+
+    /* warm the cache while the sandbox goes down */
+    bool prefetched = true;
+    if (prefetchLimit && !noexec && !forceTest && !traceReplaying())
+        startPrefetch();
+
+    /* done with the index, a mapping we keep would make every other launcher's refresh fail to replace it */
+    steamIndexClose();
+
     if (forceTerminate || forceClear)
     {
         consoleAttribute(WHITE);
         if (verboseOutput)
-            wcout << "Terminating sandbox " << sandboxieBox << endl;
+            consoleWrite(TEXT("Terminating sandbox ") + sandboxieBox + TEXT("\n"));
 
         commandLine = buildTerminateCommandLine(ok);
 
         if (!ok) showArgsHelp();
 
-        execute(commandLine, ok, errorCode, true);
-        if (!ok) showWindowsError(errorCode);
+        execute(LaunchPhase::Terminate, commandLine, ok, errorCode, true);
+        if (!ok) showExecuteError(LaunchPhase::Terminate, errorCode);
     }
 
     if (forceClear)
     {
         consoleAttribute(WHITE);
         if (verboseOutput)
-            wcout << "Clearing sandbox " << sandboxieBox << endl;
+            consoleWrite(TEXT("Clearing sandbox ") + sandboxieBox + TEXT("\n"));
 
         commandLine = buildCleanCommandLine(ok);
         if (!ok) showArgsHelp();
 
-        execute(commandLine, ok, errorCode, true);
-        if (!ok) showWindowsError(errorCode);
+        execute(LaunchPhase::Clear, commandLine, ok, errorCode, true);
+        if (!ok) showExecuteError(LaunchPhase::Clear, errorCode);
     }
 
     /* Check if we got steam */
     path = checkSteam(ok);
-    if (!ok)
+    if (!ok && !traceReplaying())
     {
         wstring msg = TEXT("Steam could not be found at the given path:\r\n");
         msg.append(path);
-        showMessage(TEXT("SandboxieStreamLauncher: Steam not found!"), msg.data(), MB_ICONERROR);
+        showMessage(TEXT("SandboxieStreamLauncher: Steam not found!"), msg.data(), MB_ICONERROR, true, LAUNCH_EXIT_NOT_FOUND);
     }
 
     /* ... and finally run it (hopefully)... */
@@ -621,18 +1464,57 @@ void wmain( int argc, wchar_t** argv)
         /* Lets assemble it all... */
         consoleAttribute(WHITE);
         if (verboseOutput)
-            wcout << "Launching sandbox " << sandboxieBox << endl;
+            consoleWrite(TEXT("Launching sandbox ") + sandboxieBox + TEXT("\n"));
 
         commandLine = buildLaunchCommandLine(ok);
         if (!ok) showArgsHelp();
 
-        execute(commandLine, ok, errorCode, true);
+        /* only a short wait here, every other launch of this box is waiting for the lock */
+        if (prefetchLimit && !forceTest && !traceReplaying())
+            prefetched = waitPrefetch(PREFETCH_LOCKED_TIMEOUT);
+
+        execute(LaunchPhase::Launch, commandLine, ok, errorCode, true);
+        if (!ok) showExecuteError(LaunchPhase::Launch, errorCode);
+    }
+
+    /* keep the numbers of real runs, still under the box lock so nobody else writes the file */
+    if (!forceTest && !traceReplaying())
+    {
+        statsRecord(StatsPhase::LockWait, lockWait);
+        statsRecord(StatsPhase::Total, microseconds() - started);
+        statsSave(sandboxieBox, ok, errorCode);
+        if (!ok && verboseOutput)
+            consoleWrite(TEXT("Could not save the launch times, Windows error ") + to_wstring(errorCode) + TEXT("\n"));
+    }
+
+    journalFlush(ok, errorCode);
+    if (!ok && verboseOutput)
+        consoleWrite(TEXT("Could not write the journal, Windows error ") + to_wstring(errorCode) + TEXT("\n"));
+
+    boxUnlock();
+    traceRecordClose();
+
+    /* Steam is starting, let the prefetch finish without holding up the next launch */
+    if (!prefetched)
+        waitPrefetch(PREFETCH_DEFAULT_TIMEOUT);
+
+    /* the box is free again, from here on we only wait for Steam to go away */
+    if (superviseBox && !noexec && !forceTest && !traceReplaying())
+    {
+        consoleAttribute(WHITE);
+        supervise(sandboxiePath, sandboxieBox, steamExe, lockTimeout, relaunch, ok, errorCode);
+        if (!ok && errorCode==ERROR_RETRY)
+        {
+            wstring msg = TEXT("Steam keeps crashing in the sandbox, gave up restarting it:\r\n");
+            msg.append(sandboxieBox);
+            showMessage(TEXT("SandboxieStreamLauncher: Steam crashing!"), msg.data(), MB_ICONERROR);
+        }
         if (!ok) showWindowsError(errorCode);
     }
 
     consoleReset(); /* We are done reset the console...*/
 
-    return;
+    return LAUNCH_EXIT_OK;
 }
 
 
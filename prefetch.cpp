@@ -0,0 +1,305 @@
+/**************************************************************************
+    prefetch.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File prefetch.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <wctype.h>
+
+#include "prefetch.h"
+#include "storage.h"
+#include "utf.h"
+
+using namespace std;
+
+#define READ_CHUNK (1024 * 1024)
+#define PAGE 4096
+
+/* PrefetchVirtualMemory is Windows 8+, so we look it up instead of linking it */
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFunc)(HANDLE, ULONG_PTR, WIN32_MEMORY_RANGE_ENTRY *, ULONG);
+
+struct PrefetchFile
+{
+    wstring name;
+    unsigned long long size;
+    bool program;
+};
+
+/* Shared between the worker threads, they take the next file by index */
+static volatile LONG _prefetchNext = 0;
+static volatile LONG _prefetchDone = 0;
+static volatile LONG _prefetchMissing = 0;
+static volatile LONGLONG _prefetchBytes = 0;
+static vector<HANDLE> _prefetchThreads;
+static wstring _prefetchListName;
+
+static bool isProgram(const wstring &fileName)
+{
+    wstring lower = toLower(fileName);
+    size_t dot = lower.find_last_of('.');
+    if (dot==wstring::npos)
+        return false;
+
+    wstring extension = lower.substr(dot);
+    return extension==TEXT(".exe") || extension==TEXT(".dll");
+}
+
+static void collectFiles(const wstring &folder, bool recursive, bool programsOnly, vector<PrefetchFile> &files)
+{
+    wstring pattern(folder);
+    pattern.append(TEXT("\\*"));
+
+    WIN32_FIND_DATAW findData;
+    HANDLE handle = FindFirstFileExW(pattern.data(), FindExInfoBasic, &findData, FindExSearchNameMatch,
+                                     nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (handle==INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        wstring name(findData.cFileName);
+        if (name==TEXT(".") || name==TEXT(".."))
+            continue;
+
+        wstring path(folder);
+        path.append(TEXT("\\"));
+        path.append(name);
+
+        if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            if (recursive)
+                collectFiles(path, recursive, programsOnly, files);
+            continue;
+        }
+
+        PrefetchFile file;
+        file.name = path;
+        file.size = (static_cast<unsigned long long>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+        file.program = isProgram(name);
+        if (file.program || !programsOnly)
+            files.push_back(file);
+    } while (FindNextFileW(handle, &findData));
+
+    FindClose(handle);
+}
+
+/* Takes the saved list of the app or makes a new one from its install folder */
+vector<wstring> prefetchFileList(DWORD appId, const wstring &steamPath, const wstring &installDir, unsigned long long limit)
+{
+    vector<wstring> list;
+
+    bool ok;
+    _prefetchListName = dataPath(TEXT("prefetch"), ok);
+    _prefetchListName.append(to_wstring(appId));
+    _prefetchListName.append(TEXT(".lst"));
+
+    DWORD errorCode;
+    string data;
+    if (ok)
+        readFile(_prefetchListName, data, ok, errorCode);
+    if (ok)
+    {
+        wstring text = utf8ToWide(data);
+        size_t pos = 0;
+        while (pos<text.length())
+        {
+            size_t end = text.find('\n', pos);
+            if (end==wstring::npos)
+                end = text.length();
+
+            wstring line = text.substr(pos, end - pos);
+            if (!line.empty() && line.back()=='\r')
+                line.pop_back();
+            if (!line.empty() && line.at(0)!='#')
+                list.push_back(line);
+            pos = end + 1;
+        }
+        return list;
+    }
+
+    /* steam itself, then the game: programs and libraries first, then the rest smallest first */
+    vector<PrefetchFile> files;
+    wstring steamFolder(steamPath);
+    if (!steamFolder.empty() && steamFolder.back()=='\\')
+        steamFolder.pop_back();
+    collectFiles(steamFolder, false, true, files);
+    size_t steamFiles = files.size();
+
+    collectFiles(installDir, true, false, files);
+    stable_sort(files.begin() + static_cast<long>(steamFiles), files.end(), [](const PrefetchFile &a, const PrefetchFile &b) {
+        if (a.program!=b.program)
+            return a.program;
+        return a.size<b.size;
+    });
+
+    unsigned long long total = 0;
+    string text("# SandboxLauncher prefetch list, one file per line\r\n");
+    for (const PrefetchFile &file : files)
+    {
+        if (total + file.size>limit)
+            continue;
+
+        total += file.size;
+        list.push_back(file.name);
+        text.append(wideToUtf8(file.name));
+        text.append("\r\n");
+    }
+
+    writeFileAtomic(_prefetchListName, text, ok, errorCode);
+    return list;
+}
+
+/*
+ * Reads one file into the cache. With PrefetchVirtualMemory the whole file is
+ * requested at once and we just touch the pages to wait for it, otherwise we
+ * read it in big chunks. Either way the data ends up in the standby list.
+ */
+static bool prefetchFile(const wstring &fileName, PrefetchVirtualMemoryFunc prefetchMemory, vector<char> &buffer,
+                         unsigned long long &bytes)
+{
+    bytes = 0;
+    HANDLE file = CreateFileW(fileName.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file==INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart==0)
+    {
+        CloseHandle(file);
+        return true;
+    }
+
+    bool done = false;
+    if (prefetchMemory && static_cast<unsigned long long>(size.QuadPart)<=static_cast<SIZE_T>(-1))
+    {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const volatile char *view = mapping ? static_cast<const volatile char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (view)
+        {
+            WIN32_MEMORY_RANGE_ENTRY range;
+            range.VirtualAddress = const_cast<char *>(view);
+            range.NumberOfBytes = static_cast<SIZE_T>(size.QuadPart);
+            prefetchMemory(GetCurrentProcess(), 1, &range, 0);
+
+            char sink = 0;
+            for (SIZE_T pos = 0; pos<range.NumberOfBytes; pos += PAGE)
+                sink ^= view[pos];
+            (void)sink;
+
+            UnmapViewOfFile(const_cast<char *>(view));
+            bytes = static_cast<unsigned long long>(size.QuadPart);
+            done = true;
+        }
+        if (mapping)
+            CloseHandle(mapping);
+    }
+
+    if (!done)
+    {
+        DWORD read = 0;
+        while (ReadFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &read, nullptr) && read>0)
+            bytes += read;
+    }
+
+    CloseHandle(file);
+    return true;
+}
+
+static DWORD WINAPI prefetchThread(LPVOID param)
+{
+    const vector<wstring> &prefetchFiles = *static_cast<const vector<wstring> *>(param);
+    PrefetchVirtualMemoryFunc prefetchMemory = reinterpret_cast<PrefetchVirtualMemoryFunc>(
+                GetProcAddress(GetModuleHandleW(TEXT("kernel32.dll")), "PrefetchVirtualMemory"));
+    vector<char> buffer(READ_CHUNK);
+
+    for (;;)
+    {
+        LONG idx = InterlockedIncrement(&_prefetchNext) - 1;
+        if (idx>=static_cast<LONG>(prefetchFiles.size()))
+            break;
+
+        unsigned long long bytes;
+        if (!prefetchFile(prefetchFiles.at(static_cast<size_t>(idx)), prefetchMemory, buffer, bytes))
+            InterlockedIncrement(&_prefetchMissing);
+
+        InterlockedExchangeAdd64(&_prefetchBytes, static_cast<LONGLONG>(bytes));
+        InterlockedIncrement(&_prefetchDone);
+    }
+
+    return 0;
+}
+
+/*
+ * Starts reading in the background, a few threads so the disk queue stays full.
+ * The workers may still run while we exit after a timeout, so their copy of the
+ * list is never freed. No static destructor can pull it away under them.
+ */
+void prefetchStart(const vector<wstring> &files, unsigned int threads)
+{
+    vector<wstring> *prefetchFiles = new vector<wstring>(files);
+    _prefetchNext = 0;
+    _prefetchDone = 0;
+    _prefetchMissing = 0;
+    _prefetchBytes = 0;
+
+    threads = max(1u, min(threads, static_cast<unsigned int>(files.size())));
+    for (unsigned int idx = 0; idx<threads && !files.empty(); idx++)
+    {
+        HANDLE thread = CreateThread(nullptr, 0, prefetchThread, prefetchFiles, 0, nullptr);
+        if (thread)
+            _prefetchThreads.push_back(thread);
+    }
+}
+
+/*
+ * Waits until everything is read or timeout ms are over. Returns false on
+ * timeout, the threads just keep going then. If files of the list are gone
+ * (game update) the list is dropped and made again next time.
+ */
+bool prefetchWait(DWORD timeout, unsigned long long &bytes, unsigned int &files)
+{
+    bool finished = true;
+    ULONGLONG until = GetTickCount64() + timeout;
+
+    for (HANDLE thread : _prefetchThreads)
+    {
+        ULONGLONG now = GetTickCount64();
+        DWORD left = now<until ? static_cast<DWORD>(until - now) : 0;
+        if (WaitForSingleObject(thread, left)!=WAIT_OBJECT_0)
+            finished = false;
+    }
+
+    if (finished)
+    {
+        for (HANDLE thread : _prefetchThreads)
+            CloseHandle(thread);
+        _prefetchThreads.clear();
+
+        if (_prefetchMissing && !_prefetchListName.empty())
+            DeleteFileW(_prefetchListName.data());
+    }
+
+    bytes = static_cast<unsigned long long>(_prefetchBytes);
+    files = static_cast<unsigned int>(_prefetchDone);
+    return finished;
+}
@@ -0,0 +1,50 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+/**************************************************************************
+    prefetch.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File prefetch.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Warms the file cache with the Steam and game binaries while the sandbox is
+ * still being terminated and cleared, so the first launch after a reboot or a
+ * /clear does not wait for the disk file by file.
+ *
+ * The files to read come from prefetch\<appid>.lst in our data folder. If
+ * there is none it is made from the install folder (programs and libraries
+ * first, then the rest, smallest first, up to the size limit). It is a plain
+ * text file, one path per line, so it can be trimmed by hand.
+ */
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define PREFETCH_DEFAULT_LIMIT (1024ull * 1024 * 1024)
+#define PREFETCH_DEFAULT_TIMEOUT 30000
+#define PREFETCH_LOCKED_TIMEOUT 2000
+
+vector<wstring> prefetchFileList(DWORD appId, const wstring &steamPath, const wstring &installDir, unsigned long long limit);
+void prefetchStart(const vector<wstring> &files, unsigned int threads);
+bool prefetchWait(DWORD timeout, unsigned long long &bytes, unsigned int &files);
+
+#endif // PREFETCH_H
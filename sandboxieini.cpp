@@ -0,0 +1,381 @@
+/**************************************************************************
+    sandboxieini.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File sandboxieini.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <wctype.h>
+#include <string.h>
+
+#include "sandboxieini.h"
+#include "storage.h"
+#include "utf.h"
+
+using namespace std;
+
+/* One line of the file including its line break. Key lines are split up as well */
+struct IniLine
+{
+    wstring text;
+    bool isKey;
+    wstring key;
+    wstring value;
+};
+
+/* A section, the text before the first [section] is a section without name */
+struct IniSection
+{
+    wstring name;
+    wstring raw;
+    vector<IniLine> lines;
+    bool dirty;
+};
+
+static wstring _iniFileName;
+static bool _iniLoaded = false;
+static bool _iniUnicode = true;
+static bool _iniUtf8Bom = false;
+static bool _iniClean = true;
+/* Line break of the file, new and patched lines use the same */
+static wstring _iniNewline(TEXT("\r\n"));
+static vector<IniSection> _iniSections;
+static map<wstring,size_t> _iniIndex;
+
+static wstring trim(const wstring &text)
+{
+    size_t first = text.find_first_not_of(TEXT(" \t\r\n"));
+    if (first==wstring::npos)
+        return wstring();
+    size_t last = text.find_last_not_of(TEXT(" \t\r\n"));
+    return text.substr(first, last - first + 1);
+}
+
+static IniLine parseLine(const wstring &text)
+{
+    IniLine line;
+    line.text = text;
+    line.isKey = false;
+
+    wstring content = trim(text);
+    if (content.empty() || content.at(0)=='#' || content.at(0)==';')
+        return line;
+
+    size_t idx = content.find('=');
+    if (idx==wstring::npos || idx==0)
+        return line;
+
+    line.isKey = true;
+    line.key = trim(content.substr(0, idx));
+    line.value = trim(content.substr(idx + 1));
+    return line;
+}
+
+static IniLine keyLine(const wstring &key, const wstring &value)
+{
+    wstring text(key);
+    text.append(TEXT("="));
+    text.append(value);
+    text.append(_iniNewline);
+    return parseLine(text);
+}
+
+/* Sandboxie looks next to Start.exe first and then in the windows folder, so do we */
+wstring iniDefaultPath(const wstring &sandboxiePath)
+{
+    wstring path(sandboxiePath);
+    path.append(TEXT("Sandboxie.ini"));
+    if (GetFileAttributesW(path.data())!=INVALID_FILE_ATTRIBUTES)
+        return path;
+
+    wchar_t buffer[MAX_PATH];
+    DWORD length = GetEnvironmentVariableW(TEXT("SystemRoot"), buffer, MAX_PATH);
+    if (length==0 || length>=MAX_PATH)
+        return TEXT("C:\\Windows\\Sandboxie.ini");
+
+    path.assign(buffer, length);
+    path.append(TEXT("\\Sandboxie.ini"));
+    return path;
+}
+
+/*
+ * Reads and indexes the whole file. Sandboxie writes UTF-16 with BOM, but we
+ * also take UTF-8 with or without one. If the text does not decode cleanly we
+ * can still read it, but iniSave will not write it back.
+ */
+void iniLoad(const wstring &fileName, bool &ok, DWORD &errorCode)
+{
+    _iniLoaded = false;
+    _iniUtf8Bom = false;
+    _iniClean = true;
+    _iniSections.clear();
+    _iniIndex.clear();
+    _iniFileName = fileName;
+
+    string data;
+    readFile(fileName, data, ok, errorCode);
+    if (!ok)
+        return;
+
+    wstring text;
+    _iniUnicode = data.size()>=2 && static_cast<unsigned char>(data.at(0))==0xFF && static_cast<unsigned char>(data.at(1))==0xFE;
+    if (_iniUnicode)
+    {
+        _iniClean = (data.size() - 2) % sizeof(wchar_t)==0;
+        text.resize((data.size() - 2) / sizeof(wchar_t));
+        if (!text.empty())
+            memcpy(&text[0], data.data() + 2, text.size() * sizeof(wchar_t));
+    } else if (!data.empty()) {
+        _iniUtf8Bom = data.compare(0, 3, "\xEF\xBB\xBF")==0;
+        size_t skip = _iniUtf8Bom ? 3 : 0;
+        text = utf8ToWide(data.data() + skip, data.size() - skip, _iniClean);
+    }
+
+    /* whatever the first line ends with, windows style if there is no line break at all */
+    size_t firstBreak = text.find('\n');
+    _iniNewline = firstBreak!=wstring::npos && (firstBreak==0 || text.at(firstBreak - 1)!='\r') ? TEXT("\n") : TEXT("\r\n");
+
+    IniSection section;
+    section.dirty = false;
+
+    size_t pos = 0;
+    while (pos<text.length())
+    {
+        size_t end = text.find('\n', pos);
+        end = end==wstring::npos ? text.length() : end + 1;
+        wstring lineText = text.substr(pos, end - pos);
+        pos = end;
+
+        wstring content = trim(lineText);
+        if (content.length()>1 && content.at(0)=='[' && content.find(']')!=wstring::npos)
+        {
+            _iniSections.push_back(section);
+
+            section = IniSection();
+            section.name = trim(content.substr(1, content.find(']') - 1));
+            section.dirty = false;
+        }
+
+        section.raw.append(lineText);
+        section.lines.push_back(parseLine(lineText));
+    }
+    _iniSections.push_back(section);
+
+    /* the first one wins just like in sandboxie */
+    for (size_t idx = 1; idx<_iniSections.size(); idx++)
+        _iniIndex.insert(make_pair(toLower(_iniSections.at(idx).name), idx));
+
+    _iniLoaded = true;
+}
+
+bool iniLoaded()
+{
+    return _iniLoaded;
+}
+
+/* False if iniLoad had to replace broken characters, such a file is never written back */
+bool iniClean()
+{
+    return _iniClean;
+}
+
+bool iniHasSection(const wstring &section)
+{
+    return _iniIndex.count(toLower(section))!=0;
+}
+
+/* What sandboxie accepts as a box name */
+bool iniValidBoxName(const wstring &box)
+{
+    if (box.empty() || box.length()>32)
+        return false;
+
+    for (wchar_t c : box)
+        if (!((c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='_'))
+            return false;
+
+    return true;
+}
+
+wstring iniValue(const wstring &section, const wstring &key, bool &found)
+{
+    found = false;
+    auto idx = _iniIndex.find(toLower(section));
+    if (idx==_iniIndex.end())
+        return wstring();
+
+    wstring lowerKey = toLower(key);
+    for (const IniLine &line : _iniSections.at(idx->second).lines)
+    {
+        if (line.isKey && toLower(line.key)==lowerKey)
+        {
+            found = true;
+            return line.value;
+        }
+    }
+
+    return wstring();
+}
+
+/*
+ * Sets a key, the first line with that key is patched in place. Sandboxie
+ * repeats keys like OpenFilePath on purpose, so later lines with the same key
+ * stay as they are. New keys go after the last key of the section.
+ */
+void iniSetValue(const wstring &section, const wstring &key, const wstring &value)
+{
+    auto idx = _iniIndex.find(toLower(section));
+    if (idx==_iniIndex.end())
+        return;
+
+    IniSection &iniSection = _iniSections.at(idx->second);
+    wstring lowerKey = toLower(key);
+    size_t lastKey = 0;
+
+    for (size_t pos = 0; pos<iniSection.lines.size(); pos++)
+    {
+        IniLine &line = iniSection.lines.at(pos);
+        if (!line.isKey)
+            continue;
+
+        if (toLower(line.key)!=lowerKey)
+        {
+            lastKey = pos;
+            continue;
+        }
+
+        if (line.value!=value)
+        {
+            line = keyLine(line.key, value);
+            iniSection.dirty = true;
+        }
+        return;
+    }
+
+    iniSection.lines.insert(iniSection.lines.begin() + static_cast<long>(lastKey) + 1, keyLine(key, value));
+    iniSection.dirty = true;
+}
+
+/* New box, with all keys of the template section or just enabled if there is none */
+void iniCreateSection(const wstring &section, const wstring &templateSection, bool &ok)
+{
+    ok = !iniHasSection(section);
+    if (!ok)
+        return;
+
+    vector<IniLine> keys;
+    if (!templateSection.empty())
+    {
+        auto idx = _iniIndex.find(toLower(templateSection));
+        ok = idx!=_iniIndex.end();
+        if (!ok)
+            return;
+
+        for (const IniLine &line : _iniSections.at(idx->second).lines)
+            if (line.isKey)
+                keys.push_back(keyLine(line.key, line.value));
+    } else {
+        keys.push_back(keyLine(TEXT("Enabled"), TEXT("y")));
+    }
+
+    /* the section before us has to end with a line break */
+    IniSection &last = _iniSections.back();
+    if (!last.lines.empty() && !last.lines.back().text.empty() && last.lines.back().text.back()!='\n')
+    {
+        last.lines.back().text.append(_iniNewline);
+        last.dirty = true;
+    }
+
+    IniSection iniSection;
+    iniSection.name = section;
+    iniSection.dirty = true;
+    iniSection.lines.push_back(parseLine(TEXT("[") + section + TEXT("]") + _iniNewline));
+    iniSection.lines.insert(iniSection.lines.end(), keys.begin(), keys.end());
+    iniSection.lines.push_back(parseLine(_iniNewline));
+
+    _iniSections.push_back(iniSection);
+    _iniIndex.insert(make_pair(toLower(section), _iniSections.size() - 1));
+}
+
+bool iniDirty()
+{
+    for (const IniSection &section : _iniSections)
+        if (section.dirty)
+            return true;
+    return false;
+}
+
+/* Writes the file back in its original encoding and BOM, only dirty sections are put together again */
+void iniSave(bool &ok, DWORD &errorCode)
+{
+    ok = true;
+    errorCode = 0;
+    if (!_iniLoaded || !iniDirty())
+        return;
+
+    if (!_iniClean)
+    {
+        ok = false;
+        errorCode = ERROR_INVALID_DATA;
+        return;
+    }
+
+    wstring text;
+    for (const IniSection &section : _iniSections)
+    {
+        if (!section.dirty)
+        {
+            text.append(section.raw);
+            continue;
+        }
+
+        for (const IniLine &line : section.lines)
+            text.append(line.text);
+    }
+
+    string data;
+    if (_iniUnicode)
+    {
+        data.append("\xFF\xFE");
+        data.append(reinterpret_cast<const char *>(text.data()), text.length() * sizeof(wchar_t));
+    } else {
+        if (_iniUtf8Bom)
+            data.append("\xEF\xBB\xBF");
+        data.append(wideToUtf8(text));
+    }
+
+    /* Sandboxie.ini usually has a locked down ACL, the new file has to keep it */
+    writeFileAtomic(_iniFileName, data, ok, errorCode, true);
+    if (!ok)
+        return;
+
+    for (IniSection &section : _iniSections)
+    {
+        if (!section.dirty)
+            continue;
+
+        section.raw.clear();
+        for (const IniLine &line : section.lines)
+            section.raw.append(line.text);
+        section.dirty = false;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef SANDBOXIEINI_H
+#define SANDBOXIEINI_H
+
+/**************************************************************************
+    sandboxieini.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File sandboxieini.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Sandboxie.ini access. The file is parsed once into sections and lines with
+ * an index by section name. Changes only mark their section dirty, on save the
+ * untouched sections are written back exactly as they were read, so comments
+ * and anything we do not understand survive.
+ */
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+wstring iniDefaultPath(const wstring &sandboxiePath);
+void iniLoad(const wstring &fileName, bool &ok, DWORD &errorCode);
+bool iniLoaded();
+bool iniClean();
+bool iniHasSection(const wstring &section);
+bool iniValidBoxName(const wstring &box);
+wstring iniValue(const wstring &section, const wstring &key, bool &found);
+void iniSetValue(const wstring &section, const wstring &key, const wstring &value);
+void iniCreateSection(const wstring &section, const wstring &templateSection, bool &ok);
+bool iniDirty();
+void iniSave(bool &ok, DWORD &errorCode);
+
+#endif // SANDBOXIEINI_H
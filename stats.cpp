@@ -0,0 +1,422 @@
+/**************************************************************************
+    stats.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File stats.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <wctype.h>
+#include <string.h>
+
+#include "stats.h"
+#include "storage.h"
+#include "console.h"
+
+using namespace std;
+
+#define STATS_MAGIC 0x53484C53 /* SLHS */
+#define STATS_VERSION 1
+#define STATS_PHASES static_cast<unsigned int>(StatsPhase::Count)
+
+/* 32 exact buckets for 0..31us, then 16 per power of two up to 2^40us (~12 days) */
+#define SUB_BUCKETS 32
+#define HALF_BUCKETS 16
+#define BUCKETS (SUB_BUCKETS + 36 * HALF_BUCKETS)
+
+struct Histogram
+{
+    unsigned long long count;
+    unsigned long long min;
+    unsigned long long max;
+    unsigned long long sum;
+    vector<DWORD> buckets;
+};
+
+/*
+ * File layout:
+ * FileHeader, box name (boxLength wchar_t), then per phase
+ * PhaseHeader followed by bucketCount (index, count) pairs of DWORD.
+ */
+struct FileHeader
+{
+    DWORD magic;
+    DWORD version;
+    DWORD phases;
+    DWORD boxLength;
+};
+
+struct PhaseHeader
+{
+    unsigned long long count;
+    unsigned long long min;
+    unsigned long long max;
+    unsigned long long sum;
+    DWORD bucketCount;
+    DWORD reserved;
+};
+
+static const wchar_t *_phaseNames[] = { TEXT("reload"), TEXT("terminate"), TEXT("clear"), TEXT("launch"),
+                                        TEXT("lock wait"), TEXT("total") };
+
+/* What this run measured */
+static vector<Histogram> _runStats;
+
+static void histogramInit(Histogram &histogram)
+{
+    histogram.count = 0;
+    histogram.min = 0;
+    histogram.max = 0;
+    histogram.sum = 0;
+    histogram.buckets.assign(BUCKETS, 0);
+}
+
+static unsigned int bucketIndex(unsigned long long value)
+{
+    if (value<SUB_BUCKETS)
+        return static_cast<unsigned int>(value);
+
+    unsigned int msb = 0;
+    while ((value >> (msb + 1))!=0)
+        msb++;
+
+    unsigned int shift = msb - 4;
+    unsigned int index = SUB_BUCKETS + (shift - 1) * HALF_BUCKETS + static_cast<unsigned int>(value >> shift) - HALF_BUCKETS;
+    return min(index, static_cast<unsigned int>(BUCKETS - 1));
+}
+
+/* Highest value that would land in the bucket */
+static unsigned long long bucketValue(unsigned int index)
+{
+    if (index<SUB_BUCKETS)
+        return index;
+
+    unsigned int shift = (index - SUB_BUCKETS) / HALF_BUCKETS + 1;
+    unsigned long long sub = (index - SUB_BUCKETS) % HALF_BUCKETS + HALF_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+static void histogramAdd(Histogram &histogram, unsigned long long value, unsigned long long count = 1)
+{
+    if (histogram.count==0 || value<histogram.min)
+        histogram.min = value;
+    histogram.max = max(histogram.max, value);
+    histogram.count += count;
+    histogram.sum += value * count;
+    histogram.buckets.at(bucketIndex(value)) += static_cast<DWORD>(count);
+}
+
+static void histogramMerge(Histogram &into, const Histogram &from)
+{
+    if (from.count==0)
+        return;
+
+    if (into.count==0 || from.min<into.min)
+        into.min = from.min;
+    into.max = max(into.max, from.max);
+    into.count += from.count;
+    into.sum += from.sum;
+    for (unsigned int idx = 0; idx<BUCKETS; idx++)
+        into.buckets.at(idx) += from.buckets.at(idx);
+}
+
+static unsigned long long histogramPercentile(const Histogram &histogram, double percentile)
+{
+    if (histogram.count==0)
+        return 0;
+
+    unsigned long long wanted = static_cast<unsigned long long>(percentile / 100.0 * histogram.count + 0.5);
+    wanted = max(wanted, 1ULL);
+
+    unsigned long long seen = 0;
+    for (unsigned int idx = 0; idx<BUCKETS; idx++)
+    {
+        seen += histogram.buckets.at(idx);
+        if (seen>=wanted)
+            return min(bucketValue(idx), histogram.max);
+    }
+    return histogram.max;
+}
+
+/* Weeks start on monday, so does the FILETIME epoch (1.1.1601) */
+static wstring weekName()
+{
+    const unsigned long long week = 7ULL * 24 * 60 * 60 * 10000000;
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    unsigned long long monday = fileTimeValue(now) / week * week;
+
+    FILETIME mondayTime;
+    mondayTime.dwLowDateTime = static_cast<DWORD>(monday);
+    mondayTime.dwHighDateTime = static_cast<DWORD>(monday >> 32);
+
+    SYSTEMTIME date;
+    FileTimeToSystemTime(&mondayTime, &date);
+
+    wchar_t name[16];
+    swprintf(name, 16, L"%04u-%02u-%02u", date.wYear, date.wMonth, date.wDay);
+    return name;
+}
+
+static wstring statsFileName(const wstring &box, bool &ok)
+{
+    wstring path = dataPath(TEXT("stats"), ok);
+    if (!ok)
+        return path;
+
+    path.append(weekName());
+    CreateDirectoryW(path.data(), nullptr);
+
+    wstring lowerBox(box);
+    transform(lowerBox.begin(), lowerBox.end(), lowerBox.begin(), ::towlower);
+
+    path.append(TEXT("\\"));
+    path.append(lowerBox);
+    path.append(TEXT(".hist"));
+    return path;
+}
+
+static void statsLoad(const wstring &fileName, wstring &box, vector<Histogram> &stats, bool &ok)
+{
+    stats.assign(STATS_PHASES, Histogram());
+    for (Histogram &histogram : stats)
+        histogramInit(histogram);
+
+    DWORD errorCode;
+    string data;
+    readFile(fileName, data, ok, errorCode);
+    if (!ok)
+        return;
+
+    FileHeader header;
+    ok = data.size()>=sizeof(header);
+    if (ok)
+    {
+        memcpy(&header, data.data(), sizeof(header));
+        ok = header.magic==STATS_MAGIC && header.version==STATS_VERSION && header.phases<=STATS_PHASES
+                && data.size()>=sizeof(header) + header.boxLength * sizeof(wchar_t);
+    }
+    if (!ok)
+        return;
+
+    size_t pos = sizeof(header);
+    box.assign(header.boxLength, L'\0');
+    if (header.boxLength)
+        memcpy(&box[0], data.data() + pos, header.boxLength * sizeof(wchar_t));
+    pos += header.boxLength * sizeof(wchar_t);
+
+    for (DWORD phase = 0; phase<header.phases && ok; phase++)
+    {
+        PhaseHeader phaseHeader;
+        ok = pos + sizeof(phaseHeader)<=data.size();
+        if (!ok)
+            break;
+        memcpy(&phaseHeader, data.data() + pos, sizeof(phaseHeader));
+        pos += sizeof(phaseHeader);
+
+        ok = pos + phaseHeader.bucketCount * 2 * sizeof(DWORD)<=data.size();
+        if (!ok)
+            break;
+
+        Histogram &histogram = stats.at(phase);
+        histogram.count = phaseHeader.count;
+        histogram.min = phaseHeader.min;
+        histogram.max = phaseHeader.max;
+        histogram.sum = phaseHeader.sum;
+
+        for (DWORD bucket = 0; bucket<phaseHeader.bucketCount; bucket++)
+        {
+            DWORD pair[2];
+            memcpy(pair, data.data() + pos, sizeof(pair));
+            pos += sizeof(pair);
+            if (pair[0]<BUCKETS)
+                histogram.buckets.at(pair[0]) += pair[1];
+        }
+    }
+}
+
+StatsPhase statsPhase(LaunchPhase phase)
+{
+    return static_cast<StatsPhase>(static_cast<unsigned int>(phase));
+}
+
+void statsRecord(StatsPhase phase, unsigned long long duration)
+{
+    if (_runStats.empty())
+    {
+        _runStats.assign(STATS_PHASES, Histogram());
+        for (Histogram &histogram : _runStats)
+            histogramInit(histogram);
+    }
+
+    histogramAdd(_runStats.at(static_cast<unsigned int>(phase)), duration);
+}
+
+/*
+ * Merges this run into the file of the box. Call it while holding the box
+ * lock, that is what keeps two launchers of the same box from losing samples.
+ */
+void statsSave(const wstring &box, bool &ok, DWORD &errorCode)
+{
+    ok = true;
+    errorCode = 0;
+    if (_runStats.empty())
+        return;
+
+    wstring fileName = statsFileName(box, ok);
+    if (!ok)
+    {
+        errorCode = ERROR_PATH_NOT_FOUND;
+        return;
+    }
+
+    bool loaded;
+    wstring fileBox;
+    vector<Histogram> stats;
+    statsLoad(fileName, fileBox, stats, loaded);
+    if (!loaded)
+    {
+        for (Histogram &histogram : stats)
+            histogramInit(histogram);
+    }
+
+    for (unsigned int phase = 0; phase<STATS_PHASES; phase++)
+        histogramMerge(stats.at(phase), _runStats.at(phase));
+
+    FileHeader header = { STATS_MAGIC, STATS_VERSION, STATS_PHASES, static_cast<DWORD>(box.length()) };
+    string data(reinterpret_cast<const char *>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char *>(box.data()), box.length() * sizeof(wchar_t));
+
+    for (const Histogram &histogram : stats)
+    {
+        PhaseHeader phaseHeader = { histogram.count, histogram.min, histogram.max, histogram.sum, 0, 0 };
+        string buckets;
+        for (DWORD idx = 0; idx<BUCKETS; idx++)
+        {
+            if (histogram.buckets.at(idx)==0)
+                continue;
+
+            DWORD pair[2] = { idx, histogram.buckets.at(idx) };
+            buckets.append(reinterpret_cast<const char *>(pair), sizeof(pair));
+            phaseHeader.bucketCount++;
+        }
+
+        data.append(reinterpret_cast<const char *>(&phaseHeader), sizeof(phaseHeader));
+        data.append(buckets);
+    }
+
+    writeFileAtomic(fileName, data, ok, errorCode);
+    if (ok)
+        _runStats.clear();
+}
+
+static wstring formatDuration(unsigned long long duration)
+{
+    wchar_t text[32];
+    if (duration<10000)
+        swprintf(text, 32, L"%.2f ms", duration / 1000.0);
+    else if (duration<10000000)
+        swprintf(text, 32, L"%.0f ms", duration / 1000.0);
+    else
+        swprintf(text, 32, L"%.1f s", duration / 1000000.0);
+    return text;
+}
+
+static void printHistogram(const wstring &box, unsigned int phase, const Histogram &histogram)
+{
+    wstring line = consolePad(box, 24) + consolePad(_phaseNames[phase], 12)
+                 + consolePad(to_wstring(histogram.count), 8, true)
+                 + consolePad(formatDuration(histogramPercentile(histogram, 50.0)), 12, true)
+                 + consolePad(formatDuration(histogramPercentile(histogram, 90.0)), 12, true)
+                 + consolePad(formatDuration(histogramPercentile(histogram, 99.0)), 12, true)
+                 + consolePad(formatDuration(histogram.max), 12, true);
+    line.append(TEXT("\n"));
+    consoleWrite(line);
+}
+
+/* Prints this weeks percentiles of one box, or of every box plus all of them together */
+void statsPrint(const wstring &box)
+{
+    bool ok;
+    wstring path = dataPath(TEXT("stats"), ok);
+    path.append(weekName());
+
+    wstring pattern(path);
+    pattern.append(TEXT("\\*.hist"));
+
+    wstring lowerBox(box);
+    transform(lowerBox.begin(), lowerBox.end(), lowerBox.begin(), ::towlower);
+
+    vector<Histogram> all(STATS_PHASES, Histogram());
+    for (Histogram &histogram : all)
+        histogramInit(histogram);
+
+    consoleWrite(TEXT("Launch times for the week of ") + weekName() + TEXT("\n\n"));
+    consoleWrite(consolePad(TEXT("Sandbox"), 24) + consolePad(TEXT("Phase"), 12) + consolePad(TEXT("Count"), 8, true)
+                 + consolePad(TEXT("p50"), 12, true) + consolePad(TEXT("p90"), 12, true) + consolePad(TEXT("p99"), 12, true)
+                 + consolePad(TEXT("max"), 12, true) + TEXT("\n"));
+
+    unsigned int boxes = 0;
+    WIN32_FIND_DATAW findData;
+    HANDLE handle = ok ? FindFirstFileW(pattern.data(), &findData) : INVALID_HANDLE_VALUE;
+    if (handle!=INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            wstring fileName(path);
+            fileName.append(TEXT("\\"));
+            fileName.append(findData.cFileName);
+
+            wstring fileBox;
+            vector<Histogram> stats;
+            statsLoad(fileName, fileBox, stats, ok);
+            if (!ok)
+                continue;
+
+            wstring lowerFileBox(fileBox);
+            transform(lowerFileBox.begin(), lowerFileBox.end(), lowerFileBox.begin(), ::towlower);
+            if (!box.empty() && lowerFileBox!=lowerBox)
+                continue;
+
+            boxes++;
+            for (unsigned int phase = 0; phase<STATS_PHASES; phase++)
+            {
+                histogramMerge(all.at(phase), stats.at(phase));
+                if (stats.at(phase).count)
+                    printHistogram(fileBox, phase, stats.at(phase));
+            }
+        } while (FindNextFileW(handle, &findData));
+
+        FindClose(handle);
+    }
+
+    if (boxes>1)
+    {
+        consoleWrite(TEXT("\n"));
+        for (unsigned int phase = 0; phase<STATS_PHASES; phase++)
+            if (all.at(phase).count)
+                printHistogram(TEXT("(all)"), phase, all.at(phase));
+    }
+
+    if (boxes==0)
+        consoleWrite(TEXT("Nothing recorded yet.\n"));
+}
@@ -0,0 +1,50 @@
+#ifndef STATS_H
+#define STATS_H
+
+/**************************************************************************
+    stats.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File stats.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Launch timing histograms. Every run adds its phase timings to a histogram
+ * file per box and week (stats\<monday>\<box>.hist), /stats merges them and
+ * prints the percentiles.
+ *
+ * The buckets are log linear like HdrHistogram: 16 buckets per power of two,
+ * so any value is off by at most ~6% and a week of launches fits in a few
+ * hundred bytes.
+ */
+
+#include <Windows.h>
+#include <string>
+
+#include "trace.h"
+
+using namespace std;
+
+/* The process phases use the same order as LaunchPhase */
+enum class StatsPhase : unsigned int { Reload = 0, Terminate, Clear, Launch, LockWait, Total, Count };
+
+StatsPhase statsPhase(LaunchPhase phase);
+void statsRecord(StatsPhase phase, unsigned long long duration);
+void statsSave(const wstring &box, bool &ok, DWORD &errorCode);
+void statsPrint(const wstring &box);
+
+#endif // STATS_H
@@ -0,0 +1,666 @@
+/**************************************************************************
+    steamlibrary.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File steamlibrary.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <wctype.h>
+
+#include "steamlibrary.h"
+#include "storage.h"
+#include "utf.h"
+
+using namespace std;
+
+/*
+ * On disk layout, all little endian:
+ *
+ * IndexHeader
+ * IndexLibrary[libraryCount]
+ * IndexApp[appCount]          sorted by appId
+ * wchar_t[stringLength]       all strings, not zero terminated
+ *
+ * The steam path the index was built for is string 0..rootLength, if the
+ * user points us to another steam we start over.
+ */
+#define INDEX_MAGIC 0x58494C53 /* SLIX */
+#define INDEX_VERSION 1
+
+struct IndexHeader
+{
+    DWORD magic;
+    DWORD version;
+    DWORD rootLength;
+    DWORD libraryCount;
+    DWORD appCount;
+    DWORD stringLength;
+};
+
+struct IndexLibrary
+{
+    DWORD pathOffset;
+    DWORD pathLength;
+};
+
+struct IndexApp
+{
+    DWORD appId;
+    DWORD library;
+    DWORD nameOffset;
+    DWORD nameLength;
+    DWORD installOffset;
+    DWORD installLength;
+    DWORD manifestSize;
+    DWORD reserved;
+    unsigned long long manifestTime;
+};
+
+/* What we know about one manifest while building the index */
+struct ManifestEntry
+{
+    DWORD appId;
+    DWORD library;
+    wstring name;
+    wstring installDir;
+    DWORD manifestSize;
+    unsigned long long manifestTime;
+};
+
+/* The current mapping, or the entries of the last refresh if we could not write it */
+static HANDLE _hIndexFile = INVALID_HANDLE_VALUE;
+static HANDLE _hIndexMapping = nullptr;
+static const BYTE *_indexView = nullptr;
+static const IndexHeader *_indexHeader = nullptr;
+static const IndexLibrary *_indexLibraries = nullptr;
+static const IndexApp *_indexApps = nullptr;
+static const wchar_t *_indexStrings = nullptr;
+static vector<IndexApp> _memoryApps;
+static vector<wstring> _memoryLibraries;
+static wstring _memoryStrings;
+
+static wstring indexFileName(bool &ok)
+{
+    wstring path = dataPath(ok);
+    path.append(TEXT("steamapps.idx"));
+    return path;
+}
+
+/* Library paths always end with a \ and compare case insensitive */
+static wstring libraryPath(const wstring &path)
+{
+    wstring result(path);
+    if (result.empty() || result.at(result.length()-1)!='\\')
+        result.append(TEXT("\\"));
+    return result;
+}
+
+/*
+ * Minimal KeyValues (vdf/acf) reader. Only string values are returned, the
+ * depth tells us how deep in { } the pair was found.
+ */
+struct VdfPair
+{
+    int depth;
+    string key;
+    string value;
+};
+
+static bool vdfToken(const string &text, size_t &pos, string &token, bool &quoted)
+{
+    while (pos<text.size())
+    {
+        char c = text.at(pos);
+        if (c==' ' || c=='\t' || c=='\r' || c=='\n')
+        {
+            pos++;
+        } else if (c=='/' && pos+1<text.size() && text.at(pos+1)=='/') {
+            while (pos<text.size() && text.at(pos)!='\n')
+                pos++;
+        } else {
+            break;
+        }
+    }
+
+    if (pos>=text.size())
+        return false;
+
+    token.clear();
+    quoted = false;
+
+    char c = text.at(pos);
+    if (c=='{' || c=='}')
+    {
+        token.push_back(c);
+        pos++;
+        return true;
+    }
+
+    if (c=='"')
+    {
+        quoted = true;
+        pos++;
+        while (pos<text.size() && text.at(pos)!='"')
+        {
+            c = text.at(pos++);
+            if (c=='\\' && pos<text.size())
+            {
+                c = text.at(pos++);
+                if (c=='n')
+                    c = '\n';
+                else if (c=='t')
+                    c = '\t';
+            }
+            token.push_back(c);
+        }
+        pos++;
+        return true;
+    }
+
+    while (pos<text.size() && text.at(pos)!=' ' && text.at(pos)!='\t' && text.at(pos)!='\r' && text.at(pos)!='\n'
+           && text.at(pos)!='{' && text.at(pos)!='}')
+        token.push_back(text.at(pos++));
+    return true;
+}
+
+static vector<VdfPair> vdfPairs(const string &text)
+{
+    vector<VdfPair> pairs;
+    size_t pos = 0;
+    int depth = 0;
+    string key;
+    bool haveKey = false;
+    string token;
+    bool quoted;
+
+    /* skip an utf8 bom */
+    if (text.size()>=3 && text.compare(0, 3, "\xEF\xBB\xBF")==0)
+        pos = 3;
+
+    while (vdfToken(text, pos, token, quoted))
+    {
+        if (!quoted && token=="{")
+        {
+            depth++;
+            haveKey = false;
+        } else if (!quoted && token=="}") {
+            depth--;
+            haveKey = false;
+        } else if (!haveKey) {
+            key = token;
+            haveKey = true;
+        } else {
+            VdfPair pair = { depth, key, token };
+            pairs.push_back(pair);
+            haveKey = false;
+        }
+    }
+
+    return pairs;
+}
+
+/* All library folders, the steam folder itself is always the first one */
+static vector<wstring> readLibraries(const wstring &steamPath)
+{
+    vector<wstring> libraries;
+    vector<wstring> lowerLibraries;
+    libraries.push_back(libraryPath(steamPath));
+    lowerLibraries.push_back(toLower(libraries.back()));
+
+    wstring vdfName(libraryPath(steamPath));
+    vdfName.append(TEXT("steamapps\\libraryfolders.vdf"));
+
+    bool ok;
+    DWORD errorCode;
+    string text;
+    readFile(vdfName, text, ok, errorCode);
+    if (!ok)
+        return libraries;
+
+    /*
+     * New format: "libraryfolders" { "0" { "path" "D:\\Steam" ... } }
+     * Old format: "LibraryFolders" { "1" "D:\\Steam" }
+     */
+    vector<VdfPair> pairs = vdfPairs(text);
+    for (const VdfPair &pair : pairs)
+    {
+        bool isPath = pair.key=="path";
+        bool isOldPath = pair.depth==1 && !pair.key.empty() && all_of(pair.key.begin(), pair.key.end(), [](char c) { return c>='0' && c<='9'; });
+        if (!isPath && !isOldPath)
+            continue;
+
+        wstring path = libraryPath(utf8ToWide(pair.value));
+        wstring lowerPath = toLower(path);
+        if (find(lowerLibraries.begin(), lowerLibraries.end(), lowerPath)==lowerLibraries.end())
+        {
+            libraries.push_back(path);
+            lowerLibraries.push_back(lowerPath);
+        }
+    }
+
+    return libraries;
+}
+
+static void parseManifest(const wstring &fileName, const wstring &library, ManifestEntry &entry, bool &ok)
+{
+    DWORD errorCode;
+    string text;
+    readFile(fileName, text, ok, errorCode);
+    if (!ok)
+        return;
+
+    bool haveId = false;
+    vector<VdfPair> pairs = vdfPairs(text);
+    for (const VdfPair &pair : pairs)
+    {
+        if (pair.depth!=1)
+            continue;
+
+        if (pair.key=="appid" && !haveId)
+        {
+            entry.appId = strtoul(pair.value.data(), nullptr, 10);
+            haveId = true;
+        } else if (pair.key=="name" && entry.name.empty()) {
+            entry.name = utf8ToWide(pair.value);
+        } else if (pair.key=="installdir" && entry.installDir.empty()) {
+            entry.installDir = library;
+            entry.installDir.append(TEXT("steamapps\\common\\"));
+            entry.installDir.append(utf8ToWide(pair.value));
+        }
+    }
+
+    ok = haveId && entry.appId!=0;
+}
+
+void steamIndexClose()
+{
+    if (_indexView)
+        UnmapViewOfFile(_indexView);
+    if (_hIndexMapping)
+        CloseHandle(_hIndexMapping);
+    if (_hIndexFile!=INVALID_HANDLE_VALUE)
+        CloseHandle(_hIndexFile);
+
+    _indexView = nullptr;
+    _hIndexMapping = nullptr;
+    _hIndexFile = INVALID_HANDLE_VALUE;
+    _indexHeader = nullptr;
+    _indexLibraries = nullptr;
+    _indexApps = nullptr;
+    _indexStrings = nullptr;
+}
+
+/* True when offset..offset+length lies inside the string table */
+static bool spanValid(DWORD offset, DWORD length, DWORD stringLength)
+{
+    return offset<=stringLength && length<=stringLength-offset;
+}
+
+/* Every string an entry points to must be inside the table, else we rebuild */
+static bool indexSpansValid()
+{
+    DWORD stringLength = _indexHeader->stringLength;
+    for (DWORD idx = 0; idx<_indexHeader->libraryCount; idx++)
+        if (!spanValid(_indexLibraries[idx].pathOffset, _indexLibraries[idx].pathLength, stringLength))
+            return false;
+    for (DWORD idx = 0; idx<_indexHeader->appCount; idx++)
+    {
+        const IndexApp &entry = _indexApps[idx];
+        if (!spanValid(entry.nameOffset, entry.nameLength, stringLength)
+                || !spanValid(entry.installOffset, entry.installLength, stringLength))
+            return false;
+    }
+    return true;
+}
+
+/* Maps the index if it exists, is sane and was built for this steam path */
+void steamIndexOpen(const wstring &steamPath, bool &ok)
+{
+    steamIndexClose();
+
+    wstring fileName = indexFileName(ok);
+    if (!ok)
+        return;
+
+    _hIndexFile = CreateFileW(fileName.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    ok = _hIndexFile!=INVALID_HANDLE_VALUE;
+    if (!ok)
+        return;
+
+    LARGE_INTEGER size;
+    ok = GetFileSizeEx(_hIndexFile, &size) && size.QuadPart>=static_cast<LONGLONG>(sizeof(IndexHeader));
+    if (ok)
+    {
+        _hIndexMapping = CreateFileMappingW(_hIndexFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ok = _hIndexMapping!=nullptr;
+    }
+    if (ok)
+    {
+        _indexView = static_cast<const BYTE *>(MapViewOfFile(_hIndexMapping, FILE_MAP_READ, 0, 0, 0));
+        ok = _indexView!=nullptr;
+    }
+    if (!ok)
+    {
+        steamIndexClose();
+        return;
+    }
+
+    _indexHeader = reinterpret_cast<const IndexHeader *>(_indexView);
+    unsigned long long expected = sizeof(IndexHeader)
+            + static_cast<unsigned long long>(_indexHeader->libraryCount) * sizeof(IndexLibrary)
+            + static_cast<unsigned long long>(_indexHeader->appCount) * sizeof(IndexApp)
+            + static_cast<unsigned long long>(_indexHeader->stringLength) * sizeof(wchar_t);
+
+    ok = _indexHeader->magic==INDEX_MAGIC && _indexHeader->version==INDEX_VERSION
+            && expected==static_cast<unsigned long long>(size.QuadPart)
+            && _indexHeader->rootLength<=_indexHeader->stringLength;
+    if (ok)
+    {
+        _indexLibraries = reinterpret_cast<const IndexLibrary *>(_indexView + sizeof(IndexHeader));
+        _indexApps = reinterpret_cast<const IndexApp *>(_indexLibraries + _indexHeader->libraryCount);
+        _indexStrings = reinterpret_cast<const wchar_t *>(_indexApps + _indexHeader->appCount);
+        ok = indexSpansValid();
+    }
+    if (ok)
+    {
+        wstring root(_indexStrings, _indexHeader->rootLength);
+        ok = toLower(root)==toLower(libraryPath(steamPath));
+    }
+
+    if (!ok)
+        steamIndexClose();
+}
+
+static DWORD appCount()
+{
+    if (_indexHeader)
+        return _indexHeader->appCount;
+    return static_cast<DWORD>(_memoryApps.size());
+}
+
+static const IndexApp &appAt(DWORD idx)
+{
+    if (_indexHeader)
+        return _indexApps[idx];
+    return _memoryApps.at(idx);
+}
+
+static wstring stringAt(DWORD offset, DWORD length)
+{
+    if (_indexHeader)
+        return wstring(_indexStrings + offset, length);
+    return _memoryStrings.substr(offset, length);
+}
+
+static wstring libraryAt(DWORD idx)
+{
+    if (_indexHeader)
+    {
+        if (idx>=_indexHeader->libraryCount)
+            return wstring();
+        return stringAt(_indexLibraries[idx].pathOffset, _indexLibraries[idx].pathLength);
+    }
+    if (idx>=_memoryLibraries.size())
+        return wstring();
+    return _memoryLibraries.at(idx);
+}
+
+static SteamApp toSteamApp(const IndexApp &entry)
+{
+    SteamApp app;
+    app.appId = entry.appId;
+    app.name = stringAt(entry.nameOffset, entry.nameLength);
+    app.installDir = stringAt(entry.installOffset, entry.installLength);
+    return app;
+}
+
+bool steamIndexEmpty()
+{
+    return appCount()==0;
+}
+
+/* Binary search over the sorted ids, this is all a normal launch costs */
+bool steamIndexLookup(DWORD appId, SteamApp &app)
+{
+    DWORD low = 0;
+    DWORD high = appCount();
+    while (low<high)
+    {
+        DWORD mid = low + (high - low) / 2;
+        const IndexApp &entry = appAt(mid);
+        if (entry.appId==appId)
+        {
+            app = toSteamApp(entry);
+            return true;
+        }
+        if (entry.appId<appId)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return false;
+}
+
+/*
+ * Name search, case insensitive. Only the best kind of match is returned:
+ * prefix, then start of a word, then anywhere, then the letters in order
+ * (so "cs go" still finds "Counter-Strike: Global Offensive").
+ */
+vector<SteamApp> steamIndexFind(const wstring &text)
+{
+    vector<SteamApp> found[4];
+    wstring search = toLower(text);
+    wstring letters;
+    for (wchar_t c : search)
+        if (iswalnum(c))
+            letters.push_back(c);
+
+    for (DWORD idx = 0; idx<appCount(); idx++)
+    {
+        const IndexApp &entry = appAt(idx);
+        wstring name = toLower(stringAt(entry.nameOffset, entry.nameLength));
+
+        size_t at = name.find(search);
+        if (at==0)
+        {
+            found[0].push_back(toSteamApp(entry));
+        } else if (at!=wstring::npos && !iswalnum(name.at(at-1))) {
+            found[1].push_back(toSteamApp(entry));
+        } else if (at!=wstring::npos) {
+            found[2].push_back(toSteamApp(entry));
+        } else if (!letters.empty()) {
+            size_t next = 0;
+            for (size_t pos = 0; pos<name.length() && next<letters.length(); pos++)
+                if (name.at(pos)==letters.at(next))
+                    next++;
+            if (next==letters.length())
+                found[3].push_back(toSteamApp(entry));
+        }
+    }
+
+    for (vector<SteamApp> &apps : found)
+    {
+        if (apps.empty())
+            continue;
+
+        sort(apps.begin(), apps.end(), [](const SteamApp &a, const SteamApp &b) { return a.name<b.name; });
+        return apps;
+    }
+
+    return vector<SteamApp>();
+}
+
+static void appendString(wstring &strings, const wstring &text, DWORD &offset, DWORD &length)
+{
+    offset = static_cast<DWORD>(strings.length());
+    length = static_cast<DWORD>(text.length());
+    strings.append(text);
+}
+
+/*
+ * Scans all libraries and rebuilds the index. Manifests that have the same
+ * size and write time as in the old index are taken over without reading
+ * them, parsed tells how many we actually had to parse.
+ */
+void steamIndexRefresh(const wstring &steamPath, bool &ok, DWORD &errorCode, unsigned int &parsed)
+{
+    ok = true;
+    errorCode = 0;
+    parsed = 0;
+
+    if (!_indexHeader)
+        steamIndexOpen(steamPath, ok);
+
+    /* what we had so far, by library path and id */
+    map<pair<wstring,DWORD>, ManifestEntry> known;
+    for (DWORD idx = 0; idx<appCount(); idx++)
+    {
+        const IndexApp &entry = appAt(idx);
+        ManifestEntry manifest;
+        manifest.appId = entry.appId;
+        manifest.library = entry.library;
+        manifest.name = stringAt(entry.nameOffset, entry.nameLength);
+        manifest.installDir = stringAt(entry.installOffset, entry.installLength);
+        manifest.manifestSize = entry.manifestSize;
+        manifest.manifestTime = entry.manifestTime;
+        known.insert(make_pair(make_pair(toLower(libraryAt(entry.library)), entry.appId), manifest));
+    }
+
+    vector<wstring> libraries = readLibraries(steamPath);
+    vector<ManifestEntry> entries;
+
+    for (DWORD library = 0; library<libraries.size(); library++)
+    {
+        wstring lowerLibrary = toLower(libraries.at(library));
+
+        wstring pattern(libraries.at(library));
+        pattern.append(TEXT("steamapps\\appmanifest_*.acf"));
+
+        WIN32_FIND_DATAW findData;
+        HANDLE handle = FindFirstFileExW(pattern.data(), FindExInfoBasic, &findData, FindExSearchNameMatch,
+                                         nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (handle==INVALID_HANDLE_VALUE)
+            continue;
+
+        do
+        {
+            DWORD appId = wcstoul(findData.cFileName + 12, nullptr, 10); /* appmanifest_ */
+            unsigned long long manifestTime = fileTimeValue(findData.ftLastWriteTime);
+
+            auto old = known.find(make_pair(lowerLibrary, appId));
+            if (old!=known.end() && old->second.manifestSize==findData.nFileSizeLow
+                    && old->second.manifestTime==manifestTime)
+            {
+                ManifestEntry entry = old->second;
+                entry.library = library;
+                entries.push_back(entry);
+                continue;
+            }
+
+            wstring fileName(libraries.at(library));
+            fileName.append(TEXT("steamapps\\"));
+            fileName.append(findData.cFileName);
+
+            ManifestEntry entry;
+            entry.appId = 0;
+            entry.library = library;
+            entry.manifestSize = findData.nFileSizeLow;
+            entry.manifestTime = manifestTime;
+
+            bool parsedOk;
+            parseManifest(fileName, libraries.at(library), entry, parsedOk);
+            parsed++;
+            if (parsedOk)
+                entries.push_back(entry);
+        } while (FindNextFileW(handle, &findData));
+
+        FindClose(handle);
+    }
+
+    /* the same app in two libraries happens after moving it, first one wins */
+    sort(entries.begin(), entries.end(), [](const ManifestEntry &a, const ManifestEntry &b) {
+        return a.appId<b.appId || (a.appId==b.appId && a.library<b.library);
+    });
+    entries.erase(unique(entries.begin(), entries.end(), [](const ManifestEntry &a, const ManifestEntry &b) {
+        return a.appId==b.appId;
+    }), entries.end());
+
+    /* build the new index in memory... */
+    steamIndexClose();
+    _memoryApps.clear();
+    _memoryLibraries = libraries;
+    _memoryStrings.clear();
+
+    DWORD rootOffset, rootLength;
+    appendString(_memoryStrings, libraryPath(steamPath), rootOffset, rootLength);
+
+    vector<IndexLibrary> indexLibraries;
+    for (const wstring &library : libraries)
+    {
+        IndexLibrary indexLibrary;
+        appendString(_memoryStrings, library, indexLibrary.pathOffset, indexLibrary.pathLength);
+        indexLibraries.push_back(indexLibrary);
+    }
+
+    for (const ManifestEntry &entry : entries)
+    {
+        IndexApp app;
+        app.appId = entry.appId;
+        app.library = entry.library;
+        appendString(_memoryStrings, entry.name, app.nameOffset, app.nameLength);
+        appendString(_memoryStrings, entry.installDir, app.installOffset, app.installLength);
+        app.manifestSize = entry.manifestSize;
+        app.reserved = 0;
+        app.manifestTime = entry.manifestTime;
+        _memoryApps.push_back(app);
+    }
+
+    IndexHeader header;
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.rootLength = rootLength;
+    header.libraryCount = static_cast<DWORD>(indexLibraries.size());
+    header.appCount = static_cast<DWORD>(_memoryApps.size());
+    header.stringLength = static_cast<DWORD>(_memoryStrings.length());
+
+    string data;
+    data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!indexLibraries.empty())
+        data.append(reinterpret_cast<const char *>(indexLibraries.data()), indexLibraries.size() * sizeof(IndexLibrary));
+    if (!_memoryApps.empty())
+        data.append(reinterpret_cast<const char *>(_memoryApps.data()), _memoryApps.size() * sizeof(IndexApp));
+    data.append(reinterpret_cast<const char *>(_memoryStrings.data()), _memoryStrings.length() * sizeof(wchar_t));
+
+    /* ...and write it. If that fails (another launcher has it mapped) we keep using the memory copy */
+    wstring fileName = indexFileName(ok);
+    if (ok)
+        writeFileAtomic(fileName, data, ok, errorCode);
+    if (ok)
+        steamIndexOpen(steamPath, ok);
+    if (ok)
+    {
+        _memoryApps.clear();
+        _memoryLibraries.clear();
+        _memoryStrings.clear();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef STEAMLIBRARY_H
+#define STEAMLIBRARY_H
+
+/**************************************************************************
+    steamlibrary.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File steamlibrary.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Index of the installed Steam apps over all library folders.
+ *
+ * Built from steamapps\libraryfolders.vdf and the appmanifest_*.acf files and
+ * kept as a memory mapped file sorted by app id. A launch only does a binary
+ * search in the mapping, the libraries are only scanned again if an id is not
+ * found and then only changed manifests are parsed.
+ */
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct SteamApp
+{
+    DWORD appId;
+    wstring name;
+    wstring installDir; /* full path of the install folder */
+};
+
+void steamIndexOpen(const wstring &steamPath, bool &ok);
+void steamIndexRefresh(const wstring &steamPath, bool &ok, DWORD &errorCode, unsigned int &parsed);
+void steamIndexClose();
+bool steamIndexEmpty();
+bool steamIndexLookup(DWORD appId, SteamApp &app);
+vector<SteamApp> steamIndexFind(const wstring &text);
+
+#endif // STEAMLIBRARY_H
@@ -0,0 +1,158 @@
+/**************************************************************************
+    storage.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File storage.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+
+#include "storage.h"
+
+using namespace std;
+
+/* Our data directory, created on first use. Empty if there is no LOCALAPPDATA */
+wstring dataPath(bool &ok)
+{
+    wchar_t buffer[MAX_PATH];
+    DWORD length = GetEnvironmentVariableW(TEXT("LOCALAPPDATA"), buffer, MAX_PATH);
+
+    ok = length!=0 && length<MAX_PATH;
+    if (!ok)
+        return wstring();
+
+    wstring path(buffer, length);
+    path.append(TEXT("\\SandboxLauncher\\"));
+    CreateDirectoryW(path.data(), nullptr);
+
+    ok = GetFileAttributesW(path.data())!=INVALID_FILE_ATTRIBUTES;
+    return path;
+}
+
+/* Same as above but for a sub directory like stats\ or logs\ */
+wstring dataPath(const wstring &subDir, bool &ok)
+{
+    wstring path = dataPath(ok);
+    if (!ok)
+        return path;
+
+    path.append(subDir);
+    path.append(TEXT("\\"));
+    CreateDirectoryW(path.data(), nullptr);
+
+    ok = GetFileAttributesW(path.data())!=INVALID_FILE_ATTRIBUTES;
+    return path;
+}
+
+/* Reads a whole file into memory. Our files are all small */
+void readFile(const wstring &fileName, string &data, bool &ok, DWORD &errorCode)
+{
+    ok = true;
+    errorCode = 0;
+    data.clear();
+
+    HANDLE handle = CreateFileW(fileName.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle==INVALID_HANDLE_VALUE)
+    {
+        ok = false;
+        errorCode = GetLastError();
+        return;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart>0x7FFFFFFF)
+    {
+        ok = false;
+        errorCode = ERROR_INVALID_DATA;
+        CloseHandle(handle);
+        return;
+    }
+
+    data.resize(static_cast<size_t>(size.QuadPart));
+    DWORD done = 0;
+    DWORD read = 0;
+    while (done<data.size())
+    {
+        if (!ReadFile(handle, &data[done], static_cast<DWORD>(data.size()) - done, &read, nullptr) || read==0)
+            break;
+        done += read;
+    }
+
+    if (done!=data.size())
+    {
+        ok = false;
+        errorCode = GetLastError();
+        data.clear();
+    }
+
+    CloseHandle(handle);
+}
+
+/*
+ * Writes to a temp file first and moves it over the old one, so readers
+ * either see the old or the new content but never half a file. With
+ * keepSecurity an existing file is swapped with ReplaceFileW instead, that
+ * keeps its ACL and attributes rather than taking the temp file's defaults.
+ */
+void writeFileAtomic(const wstring &fileName, const string &data, bool &ok, DWORD &errorCode, bool keepSecurity)
+{
+    ok = true;
+    errorCode = 0;
+
+    wstring tempName(fileName);
+    tempName.append(TEXT(".tmp"));
+    tempName.append(to_wstring(GetCurrentProcessId()));
+
+    HANDLE handle = CreateFileW(tempName.data(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle==INVALID_HANDLE_VALUE)
+    {
+        ok = false;
+        errorCode = GetLastError();
+        return;
+    }
+
+    DWORD written = 0;
+    ok = data.empty() || (WriteFile(handle, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) && written==data.size());
+    if (ok)
+        ok = FlushFileBuffers(handle);
+    if (!ok)
+        errorCode = GetLastError();
+    CloseHandle(handle);
+
+    if (ok && keepSecurity && GetFileAttributesW(fileName.data())!=INVALID_FILE_ATTRIBUTES)
+    {
+        ok = ReplaceFileW(fileName.data(), tempName.data(), nullptr, REPLACEFILE_WRITE_THROUGH | REPLACEFILE_IGNORE_MERGE_ERRORS,
+                          nullptr, nullptr);
+        if (!ok)
+            errorCode = GetLastError();
+    } else if (ok) {
+        ok = MoveFileExW(tempName.data(), fileName.data(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+        if (!ok)
+            errorCode = GetLastError();
+    }
+
+    if (!ok)
+        DeleteFileW(tempName.data());
+}
+
+/* FILETIME as one number, used to tell if a file changed */
+unsigned long long fileTimeValue(const FILETIME &fileTime)
+{
+    return (static_cast<unsigned long long>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+}
@@ -0,0 +1,41 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+/**************************************************************************
+    storage.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File storage.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Small file helpers for the stuff we keep between runs. Everything lives in
+ * %LOCALAPPDATA%\SandboxLauncher\ so we never need admin rights for it.
+ */
+
+#include <Windows.h>
+#include <string>
+
+using namespace std;
+
+wstring dataPath(bool &ok);
+wstring dataPath(const wstring &subDir, bool &ok);
+void readFile(const wstring &fileName, string &data, bool &ok, DWORD &errorCode);
+void writeFileAtomic(const wstring &fileName, const string &data, bool &ok, DWORD &errorCode, bool keepSecurity = false);
+unsigned long long fileTimeValue(const FILETIME &fileTime);
+
+#endif // STORAGE_H
@@ -0,0 +1,369 @@
+/**************************************************************************
+    supervise.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File supervise.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <TlHelp32.h>
+#include <string>
+#include <algorithm>
+
+#include "supervise.h"
+#include "boxlock.h"
+#include "console.h"
+#include "journal.h"
+#include "storage.h"
+
+using namespace std;
+
+/* LONG SbieApi_QueryProcess(HANDLE ProcessId, WCHAR *out_box_name_wchar34, WCHAR *out_image_name_wchar96, WCHAR *out_sid_wchar96, ULONG *out_session_id) */
+typedef LONG (__stdcall *SbieApiQueryProcessFunc)(HANDLE, WCHAR *, WCHAR *, WCHAR *, ULONG *);
+
+static HMODULE _sbieDll = nullptr;
+static SbieApiQueryProcessFunc _queryProcess = nullptr;
+static HANDLE _stopEvent = nullptr;
+
+/* Ctrl+C or closing the console ends supervising, not the launcher */
+static BOOL WINAPI stopHandler(DWORD ctrlType)
+{
+    if (ctrlType==CTRL_C_EVENT || ctrlType==CTRL_BREAK_EVENT || ctrlType==CTRL_CLOSE_EVENT)
+    {
+        SetEvent(_stopEvent);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const wchar_t *superviseExitName(SuperviseExit exitKind)
+{
+    switch (exitKind)
+    {
+    case SuperviseExit::Clean: return TEXT("closed");
+    case SuperviseExit::Crash: return TEXT("crashed");
+    case SuperviseExit::Error: return TEXT("failed");
+    case SuperviseExit::NotStarted: return TEXT("did not start");
+    case SuperviseExit::Stopped: return TEXT("stopped");
+    }
+    return TEXT("unknown");
+}
+
+/* 0 is Steam closed by the user, an NTSTATUS error code (0xC...) is a crash, anything else an error exit */
+SuperviseExit superviseClassify(DWORD exitCode)
+{
+    if (exitCode==0)
+        return SuperviseExit::Clean;
+    if ((exitCode & 0xC0000000)==0xC0000000)
+        return SuperviseExit::Crash;
+    return SuperviseExit::Error;
+}
+
+static bool sameText(const wstring &a, const wchar_t *b)
+{
+    return _wcsicmp(a.data(), b)==0;
+}
+
+/* Looks for imageName, or any process if it is empty, running inside the box. Returns a handle we can wait on or nullptr */
+static HANDLE findBoxedProcess(const wstring &box, const wstring &imageName)
+{
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot==INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    HANDLE process = nullptr;
+    PROCESSENTRY32W entry;
+    entry.dwSize = sizeof(entry);
+
+    for (BOOL more = Process32FirstW(snapshot, &entry); more && !process; more = Process32NextW(snapshot, &entry))
+    {
+        if (!imageName.empty() && !sameText(imageName, entry.szExeFile))
+            continue;
+
+        WCHAR boxName[34] = { 0 };
+        WCHAR image[96] = { 0 };
+        WCHAR sid[96] = { 0 };
+        ULONG session = 0;
+        if (_queryProcess(reinterpret_cast<HANDLE>(static_cast<ULONG_PTR>(entry.th32ProcessID)), boxName, image, sid, &session)!=0)
+            continue;
+
+        if (sameText(box, boxName))
+            process = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, entry.th32ProcessID);
+    }
+
+    CloseHandle(snapshot);
+    return process;
+}
+
+/*
+ * Right after a launch Steam is not there yet, Start.exe returns before it. So
+ * here we look again and again, once a second until it shows up. Returns
+ * nullptr if it never does or we got stopped.
+ */
+static HANDLE waitForBoxedProcess(const wstring &box, const wstring &imageName)
+{
+    ULONGLONG until = GetTickCount64() + SUPERVISE_START_TIMEOUT;
+    for (;;)
+    {
+        HANDLE process = findBoxedProcess(box, imageName);
+        if (process || GetTickCount64()>=until)
+            return process;
+        if (WaitForSingleObject(_stopEvent, 1000)==WAIT_OBJECT_0)
+            return nullptr;
+    }
+}
+
+/*
+ * Steam exits with 0 as well when it updates itself, then the updater or the
+ * old Steam starts a new one. As long as something is left in the box we look
+ * for that new Steam for a while. Returns nullptr once the box is empty.
+ */
+static HANDLE waitForHandover(const wstring &box, const wstring &imageName)
+{
+    ULONGLONG until = GetTickCount64() + SUPERVISE_HANDOVER_TIME;
+    for (;;)
+    {
+        HANDLE process = findBoxedProcess(box, imageName);
+        if (process)
+            return process;
+
+        HANDLE other = findBoxedProcess(box, wstring());
+        if (!other)
+            return nullptr;
+        CloseHandle(other);
+
+        if (GetTickCount64()>=until || WaitForSingleObject(_stopEvent, 1000)==WAIT_OBJECT_0)
+            return nullptr;
+    }
+}
+
+static void superviseMessage(const wstring &box, const wstring &text)
+{
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+
+    wchar_t stamp[16];
+    swprintf(stamp, 16, L"%02u:%02u:%02u ", now.wHour, now.wMinute, now.wSecond);
+    consoleWrite(stamp + box + TEXT(": ") + text + TEXT("\n"));
+}
+
+/* Supervising can run for days, so every event goes to the journal right away */
+static void superviseJournal(JournalEvent event, const wstring &box, DWORD pid, DWORD code)
+{
+    bool ok;
+    DWORD errorCode;
+    journalAppend(event, box, wstring(), 0, pid, code);
+    journalFlush(ok, errorCode);
+}
+
+static unsigned long long systemTime()
+{
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return fileTimeValue(now);
+}
+
+/*
+ * Did another launch terminate or clear the box since we last started watching it?
+ * relaunched tells if that launch started Steam again afterwards.
+ */
+static bool stoppedElsewhere(const wstring &box, unsigned long long since, bool &relaunched)
+{
+    bool ok;
+    DWORD errorCode;
+    BoxState state;
+    relaunched = false;
+    journalOpen(ok, errorCode);
+    if (!ok || !journalLookup(box, state) || state.stopped<=since)
+        return false;
+
+    relaunched = state.launched>state.stopped;
+    return true;
+}
+
+/*
+ * Runs until Steam in the box is closed normally, another launch terminates
+ * or clears the box and leaves it empty, we give up after a crash loop or get
+ * stopped with Ctrl+C.
+ * ok is false only on the crash loop or if SbieDll.dll can not be used.
+ */
+void supervise(const wstring &sandboxiePath, const wstring &box, const wstring &imageName, DWORD lockTimeout,
+               SuperviseLaunch launch, bool &ok, DWORD &errorCode)
+{
+    ok = true;
+    errorCode = 0;
+
+    if (!_sbieDll)
+    {
+        wstring dllName(sandboxiePath);
+        dllName.append(TEXT("SbieDll.dll"));
+        _sbieDll = LoadLibraryW(dllName.data());
+        if (_sbieDll)
+            _queryProcess = reinterpret_cast<SbieApiQueryProcessFunc>(GetProcAddress(_sbieDll, "SbieApi_QueryProcess"));
+    }
+
+    if (!_queryProcess)
+    {
+        ok = false;
+        errorCode = _sbieDll ? ERROR_PROC_NOT_FOUND : GetLastError();
+        return;
+    }
+
+    if (!_stopEvent)
+        _stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    SetConsoleCtrlHandler(stopHandler, TRUE);
+
+    DWORD delay = SUPERVISE_DELAY_MIN;
+    unsigned int restarts = 0;
+    unsigned long long since = systemTime();
+    HANDLE process = waitForBoxedProcess(box, imageName);
+
+    for (;;)
+    {
+        SuperviseExit exitKind = SuperviseExit::NotStarted;
+        ULONGLONG uptime = 0;
+
+        if (process)
+        {
+            superviseMessage(box, TEXT("watching ") + imageName);
+            superviseJournal(JournalEvent::Running, box, GetProcessId(process), 0);
+
+            ULONGLONG started = GetTickCount64();
+            HANDLE handles[2] = { process, _stopEvent };
+            DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+            uptime = GetTickCount64() - started;
+
+            DWORD exitCode = 0;
+            if (result==WAIT_OBJECT_0 && GetExitCodeProcess(process, &exitCode))
+                exitKind = superviseClassify(exitCode);
+            else
+                exitKind = SuperviseExit::Stopped;
+
+            CloseHandle(process);
+            process = nullptr;
+
+            if (exitKind!=SuperviseExit::Stopped)
+            {
+                superviseJournal(JournalEvent::Exited, box, 0, exitCode);
+                wchar_t code[16];
+                swprintf(code, 16, L"0x%08X", exitCode);
+                superviseMessage(box, imageName + TEXT(" ") + superviseExitName(exitKind) + TEXT(" with exit code ") + code);
+            }
+        } else {
+            superviseMessage(box, imageName + TEXT(" ") + superviseExitName(exitKind));
+        }
+
+        if (exitKind==SuperviseExit::Stopped || WaitForSingleObject(_stopEvent, 0)==WAIT_OBJECT_0)
+        {
+            superviseMessage(box, TEXT("supervising stopped"));
+            break;
+        }
+
+        if (exitKind==SuperviseExit::Clean)
+        {
+            process = waitForHandover(box, imageName);
+            if (!process)
+                break;
+            superviseMessage(box, imageName + TEXT(" restarted itself"));
+            continue;
+        }
+
+        if (uptime>=SUPERVISE_STABLE_TIME)
+        {
+            restarts = 0;
+            delay = SUPERVISE_DELAY_MIN;
+        }
+
+        if (++restarts>SUPERVISE_RESTART_LIMIT)
+        {
+            superviseMessage(box, TEXT("keeps failing, giving up"));
+            superviseJournal(JournalEvent::Failed, box, 0, ERROR_RETRY);
+            ok = false;
+            errorCode = ERROR_RETRY;
+            break;
+        }
+
+        /* someone else might be launching the box right now, so we only go on under the lock */
+        bool locked = false;
+        bool stopped = false;
+        while (!locked)
+        {
+            superviseMessage(box, TEXT("restarting in ") + to_wstring(delay / 1000) + TEXT(" seconds"));
+            if (WaitForSingleObject(_stopEvent, delay)==WAIT_OBJECT_0)
+            {
+                stopped = true;
+                break;
+            }
+            delay = min(delay * 2, static_cast<DWORD>(SUPERVISE_DELAY_MAX));
+
+            bool abandoned;
+            DWORD lockError;
+            boxLock(box, lockTimeout, locked, abandoned, lockError);
+            if (!locked)
+                superviseMessage(box, TEXT("sandbox is busy, Windows error ") + to_wstring(lockError));
+        }
+
+        if (stopped)
+        {
+            superviseMessage(box, TEXT("supervising stopped"));
+            break;
+        }
+
+        /*
+         * A /terminate or /clear from another launch ends Steam on purpose, that is no crash.
+         * Mostly that launch starts Steam again right away, then we go on watching the new one.
+         */
+        bool relaunched;
+        if (stoppedElsewhere(box, since, relaunched))
+        {
+            boxUnlock();
+            process = relaunched ? waitForBoxedProcess(box, imageName) : findBoxedProcess(box, imageName);
+            if (!process)
+            {
+                superviseMessage(box, TEXT("was terminated by another launch, supervising stopped"));
+                break;
+            }
+
+            superviseMessage(box, TEXT("was launched again by another launch"));
+            since = systemTime();
+            restarts = 0;
+            delay = SUPERVISE_DELAY_MIN;
+            continue;
+        }
+
+        process = findBoxedProcess(box, imageName);
+        if (!process)
+        {
+            bool launched;
+            DWORD launchError;
+            launch(launched, launchError);
+            if (!launched)
+                superviseMessage(box, TEXT("launch failed, Windows error ") + to_wstring(launchError));
+        }
+
+        bool flushed;
+        DWORD flushError;
+        journalFlush(flushed, flushError);
+        boxUnlock();
+
+        since = systemTime();
+        if (!process)
+            process = waitForBoxedProcess(box, imageName);
+    }
+
+    SetConsoleCtrlHandler(stopHandler, FALSE);
+}
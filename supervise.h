@@ -0,0 +1,60 @@
+#ifndef SUPERVISE_H
+#define SUPERVISE_H
+
+/**************************************************************************
+    supervise.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File supervise.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Keeps Steam in a sandbox running. We find the sandboxed Steam.exe with the
+ * help of SbieDll.dll and then just wait on its process handle, so there is
+ * nothing to do while it runs. When it goes away the exit is classified and,
+ * unless Steam was closed normally, the box is launched again with a growing
+ * delay. Too many restarts in a row without a stable run and we give up.
+ */
+
+#include <Windows.h>
+#include <string>
+
+using namespace std;
+
+/* First restart delay, doubled on every restart up to the max */
+#define SUPERVISE_DELAY_MIN 5000
+#define SUPERVISE_DELAY_MAX 300000
+/* How long Steam has to show up in the box after a launch */
+#define SUPERVISE_START_TIMEOUT 60000
+/* How long a Steam that exited with 0 has to show up again, it does that when it updates itself */
+#define SUPERVISE_HANDOVER_TIME 15000
+/* Running this long counts as stable and resets delay and restart count */
+#define SUPERVISE_STABLE_TIME 600000
+/* Restarts without a stable run in between before we give up */
+#define SUPERVISE_RESTART_LIMIT 5
+
+enum class SuperviseExit : unsigned int { Clean, Crash, Error, NotStarted, Stopped };
+
+/* Called to launch the box again, the box lock is already held */
+typedef void (*SuperviseLaunch)(bool &ok, DWORD &errorCode);
+
+const wchar_t *superviseExitName(SuperviseExit exitKind);
+SuperviseExit superviseClassify(DWORD exitCode);
+void supervise(const wstring &sandboxiePath, const wstring &box, const wstring &imageName, DWORD lockTimeout,
+               SuperviseLaunch launch, bool &ok, DWORD &errorCode);
+
+#endif // SUPERVISE_H
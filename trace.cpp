@@ -0,0 +1,246 @@
+/**************************************************************************
+    trace.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File trace.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <wctype.h>
+#include <string.h>
+
+#include "trace.h"
+#include "storage.h"
+
+using namespace std;
+
+#define TRACE_MAGIC 0x52544C53 /* SLTR */
+
+/*
+ * One record, followed by boxLength wchar_t of box name. startTime is a
+ * FILETIME so records of different launchers can be put in order, duration
+ * is in microseconds. reserved2 fills the gap before startTime, so no
+ * uninitialized padding ends up in the file.
+ */
+struct TraceRecord
+{
+    DWORD magic;
+    DWORD size;
+    DWORD processId;
+    BYTE phase;
+    BYTE ok;
+    BYTE wait;
+    BYTE reserved;
+    DWORD errorCode;
+    DWORD exitCode;
+    DWORD boxLength;
+    DWORD reserved2;
+    unsigned long long startTime;
+    unsigned long long duration;
+};
+
+static HANDLE _hTraceFile = INVALID_HANDLE_VALUE;
+static wstring _traceBox;
+static vector<TraceRecord> _replayRecords;
+static size_t _replayNext = 0;
+static bool _replayActive = false;
+static unsigned long long _replayStart = 0;
+
+const wchar_t *phaseName(LaunchPhase phase)
+{
+    switch (phase)
+    {
+    case LaunchPhase::Reload:
+        return TEXT("reload");
+    case LaunchPhase::Terminate:
+        return TEXT("terminate");
+    case LaunchPhase::Clear:
+        return TEXT("clear");
+    case LaunchPhase::Launch:
+        return TEXT("launch");
+    }
+    return TEXT("unknown");
+}
+
+/* High resolution time for measuring, only differences make sense */
+unsigned long long microseconds()
+{
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart==0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<unsigned long long>(counter.QuadPart / frequency.QuadPart) * 1000000
+            + static_cast<unsigned long long>(counter.QuadPart % frequency.QuadPart) * 1000000 / static_cast<unsigned long long>(frequency.QuadPart);
+}
+
+void traceRecordOpen(const wstring &fileName, const wstring &box, bool &ok, DWORD &errorCode)
+{
+    ok = true;
+    errorCode = 0;
+    _traceBox = box;
+
+    _hTraceFile = CreateFileW(fileName.data(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (_hTraceFile==INVALID_HANDLE_VALUE)
+    {
+        ok = false;
+        errorCode = GetLastError();
+    }
+}
+
+void traceRecord(LaunchPhase phase, bool ok, bool wait, DWORD errorCode, DWORD exitCode,
+                 unsigned long long startTime, unsigned long long duration)
+{
+    if (_hTraceFile==INVALID_HANDLE_VALUE)
+        return;
+
+    TraceRecord record;
+    record.magic = TRACE_MAGIC;
+    record.size = static_cast<DWORD>(sizeof(TraceRecord) + _traceBox.length() * sizeof(wchar_t));
+    record.processId = GetCurrentProcessId();
+    record.phase = static_cast<BYTE>(phase);
+    record.ok = ok ? 1 : 0;
+    record.wait = wait ? 1 : 0;
+    record.reserved = 0;
+    record.errorCode = errorCode;
+    record.exitCode = exitCode;
+    record.boxLength = static_cast<DWORD>(_traceBox.length());
+    record.reserved2 = 0;
+    record.startTime = startTime;
+    record.duration = duration;
+
+    /* one write per record, so parallel launchers never mix their records */
+    string data(reinterpret_cast<const char *>(&record), sizeof(record));
+    data.append(reinterpret_cast<const char *>(_traceBox.data()), _traceBox.length() * sizeof(wchar_t));
+
+    DWORD written;
+    WriteFile(_hTraceFile, data.data(), static_cast<DWORD>(data.size()), &written, nullptr);
+}
+
+void traceRecordClose()
+{
+    if (_hTraceFile!=INVALID_HANDLE_VALUE)
+    {
+        FlushFileBuffers(_hTraceFile);
+        CloseHandle(_hTraceFile);
+        _hTraceFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+/*
+ * Loads the records of our box. If the trace has more than one launcher
+ * for the box we take the first one, the next /replay run has to use a
+ * trace with the next one.
+ */
+void traceReplayOpen(const wstring &fileName, const wstring &box, bool &ok, DWORD &errorCode, size_t &count)
+{
+    _replayRecords.clear();
+    _replayNext = 0;
+    _replayStart = 0;
+    count = 0;
+
+    string data;
+    readFile(fileName, data, ok, errorCode);
+    if (!ok)
+        return;
+
+    wstring lowerBox(box);
+    transform(lowerBox.begin(), lowerBox.end(), lowerBox.begin(), ::towlower);
+
+    DWORD processId = 0;
+    size_t pos = 0;
+    while (pos + sizeof(TraceRecord)<=data.size())
+    {
+        TraceRecord record;
+        memcpy(&record, data.data() + pos, sizeof(record));
+        if (record.magic!=TRACE_MAGIC || record.size<sizeof(TraceRecord) || pos + record.size>data.size()
+                || record.size!=sizeof(TraceRecord) + record.boxLength * sizeof(wchar_t))
+        {
+            ok = false;
+            errorCode = ERROR_INVALID_DATA;
+            return;
+        }
+
+        wstring recordBox(record.boxLength, L'\0');
+        if (record.boxLength)
+            memcpy(&recordBox[0], data.data() + pos + sizeof(TraceRecord), record.boxLength * sizeof(wchar_t));
+        transform(recordBox.begin(), recordBox.end(), recordBox.begin(), ::towlower);
+        pos += record.size;
+
+        if (recordBox!=lowerBox || (processId!=0 && record.processId!=processId))
+            continue;
+
+        processId = record.processId;
+        _replayRecords.push_back(record);
+    }
+
+    count = _replayRecords.size();
+    _replayActive = true;
+}
+
+/* Even with no records for our box, replay never starts real processes */
+bool traceReplaying()
+{
+    return _replayActive;
+}
+
+/*
+ * Plays the next recorded process of that phase. First we wait until as much
+ * time has passed since the first replayed phase as had passed since the
+ * first record, then we sleep as long as the real one took if the launcher
+ * waited for it and return how it ended. A phase that was not recorded
+ * finishes right away.
+ */
+void traceReplay(LaunchPhase phase, bool &ok, DWORD &errorCode, DWORD &exitCode, unsigned long long &duration)
+{
+    ok = true;
+    errorCode = 0;
+    exitCode = 0;
+    duration = 0;
+
+    if (_replayStart==0)
+        _replayStart = microseconds();
+
+    for (size_t idx = _replayNext; idx<_replayRecords.size(); idx++)
+    {
+        const TraceRecord &record = _replayRecords.at(idx);
+        if (record.phase!=static_cast<BYTE>(phase))
+            continue;
+
+        _replayNext = idx + 1;
+        ok = record.ok!=0;
+        errorCode = record.errorCode;
+        exitCode = record.exitCode;
+        duration = record.duration;
+
+        /* startTime is in 100ns units, the clock here in microseconds */
+        unsigned long long first = _replayRecords.front().startTime;
+        unsigned long long offset = record.startTime>first ? (record.startTime - first) / 10 : 0;
+        unsigned long long elapsed = microseconds() - _replayStart;
+        if (offset>elapsed)
+            Sleep(static_cast<DWORD>((offset - elapsed) / 1000));
+
+        if (record.wait)
+            Sleep(static_cast<DWORD>(record.duration / 1000));
+        return;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**************************************************************************
+    trace.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File trace.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * Launch traces. With /record every process we start is appended to a binary
+ * trace file (which box, what for, how long it took, how it ended). With
+ * /replay we start nothing and instead take as long and end the same way as
+ * the recorded run, so timing problems from a real machine can be run again
+ * anywhere without Sandboxie or Steam installed.
+ *
+ * Several launchers can record into the same file at once, every record is
+ * written with a single append.
+ */
+
+#include <Windows.h>
+#include <string>
+
+using namespace std;
+
+/* What a started process was for */
+enum class LaunchPhase : unsigned char { Reload = 0, Terminate = 1, Clear = 2, Launch = 3 };
+
+const wchar_t *phaseName(LaunchPhase phase);
+unsigned long long microseconds();
+
+void traceRecordOpen(const wstring &fileName, const wstring &box, bool &ok, DWORD &errorCode);
+void traceRecord(LaunchPhase phase, bool ok, bool wait, DWORD errorCode, DWORD exitCode,
+                 unsigned long long startTime, unsigned long long duration);
+void traceRecordClose();
+
+void traceReplayOpen(const wstring &fileName, const wstring &box, bool &ok, DWORD &errorCode, size_t &count);
+bool traceReplaying();
+void traceReplay(LaunchPhase phase, bool &ok, DWORD &errorCode, DWORD &exitCode, unsigned long long &duration);
+
+#endif // TRACE_H
@@ -0,0 +1,257 @@
+/**************************************************************************
+    utf.cpp
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File utf.cpp created by afischer on 18.10.2026
+**************************************************************************/
+
+#include <string>
+#include <algorithm>
+#include <wctype.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2) || defined(__SSE2__)
+#define UTF_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "utf.h"
+
+using namespace std;
+
+#define REPLACEMENT 0xFFFD
+
+/*
+ * Decodes one sequence starting at data[pos] that is not ASCII. Returns the
+ * code point or -1 if the bytes at pos do not start a valid sequence, in that
+ * case only one byte is skipped so we resync on the next lead byte.
+ */
+static long decodeSequence(const unsigned char *data, size_t length, size_t &pos)
+{
+    unsigned char lead = data[pos];
+    size_t needed;
+    unsigned long codePoint;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+
+    if (lead>=0xC2 && lead<=0xDF)
+    {
+        needed = 1;
+        codePoint = lead & 0x1F;
+    } else if (lead>=0xE0 && lead<=0xEF) {
+        needed = 2;
+        codePoint = lead & 0x0F;
+        if (lead==0xE0)
+            low = 0xA0; /* overlong */
+        else if (lead==0xED)
+            high = 0x9F; /* surrogates */
+    } else if (lead>=0xF0 && lead<=0xF4) {
+        needed = 3;
+        codePoint = lead & 0x07;
+        if (lead==0xF0)
+            low = 0x90; /* overlong */
+        else if (lead==0xF4)
+            high = 0x8F; /* above U+10FFFF */
+    } else {
+        pos++;
+        return -1;
+    }
+
+    for (size_t idx = 1; idx<=needed; idx++)
+    {
+        if (pos + idx>=length)
+        {
+            pos++;
+            return -1;
+        }
+
+        unsigned char next = data[pos + idx];
+        if (next<low || next>high)
+        {
+            pos++;
+            return -1;
+        }
+
+        codePoint = (codePoint << 6) | (next & 0x3F);
+        low = 0x80;
+        high = 0xBF;
+    }
+
+    pos += needed + 1;
+    return static_cast<long>(codePoint);
+}
+
+static void appendCodePoint(wstring &text, unsigned long codePoint)
+{
+    if (codePoint<0x10000)
+    {
+        text.push_back(static_cast<wchar_t>(codePoint));
+    } else {
+        codePoint -= 0x10000;
+        text.push_back(static_cast<wchar_t>(0xD800 + (codePoint >> 10)));
+        text.push_back(static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF)));
+    }
+}
+
+wstring utf8ToWide(const char *data, size_t length, bool &valid)
+{
+    valid = true;
+    wstring text;
+    text.reserve(length);
+
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    size_t pos = 0;
+
+    while (pos<length)
+    {
+#ifdef UTF_SSE2
+        /* 16 ASCII bytes become 16 wchar_t by interleaving them with zeros */
+        if (sizeof(wchar_t)==2)
+        {
+            while (pos + 16<=length)
+            {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + pos));
+                if (_mm_movemask_epi8(chunk)!=0)
+                    break;
+
+                size_t at = text.size();
+                text.resize(at + 16);
+                __m128i zero = _mm_setzero_si128();
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(&text[at]), _mm_unpacklo_epi8(chunk, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(&text[at + 8]), _mm_unpackhi_epi8(chunk, zero));
+                pos += 16;
+            }
+
+            if (pos>=length)
+                break;
+        }
+#endif
+
+        if (bytes[pos]<0x80)
+        {
+            text.push_back(static_cast<wchar_t>(bytes[pos++]));
+            continue;
+        }
+
+        long codePoint = decodeSequence(bytes, length, pos);
+        if (codePoint<0)
+        {
+            valid = false;
+            codePoint = REPLACEMENT;
+        }
+        appendCodePoint(text, static_cast<unsigned long>(codePoint));
+    }
+
+    return text;
+}
+
+wstring utf8ToWide(const string &text)
+{
+    bool valid;
+    return utf8ToWide(text.data(), text.size(), valid);
+}
+
+static void appendUtf8(string &text, unsigned long codePoint)
+{
+    if (codePoint<0x80)
+    {
+        text.push_back(static_cast<char>(codePoint));
+    } else if (codePoint<0x800) {
+        text.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint<0x10000) {
+        text.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        text.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        text.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+string wideToUtf8(const wchar_t *data, size_t length, bool &valid)
+{
+    valid = true;
+    string text;
+    text.reserve(length);
+
+    size_t pos = 0;
+    while (pos<length)
+    {
+#ifdef UTF_SSE2
+        /* 16 wchar_t below 0x80 are packed down to 16 bytes */
+        if (sizeof(wchar_t)==2)
+        {
+            const __m128i highBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+            const __m128i zero = _mm_setzero_si128();
+            while (pos + 16<=length)
+            {
+                __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+                __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + 8));
+                __m128i high = _mm_and_si128(_mm_or_si128(first, second), highBits);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero))!=0xFFFF)
+                    break;
+
+                size_t at = text.size();
+                text.resize(at + 16);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(&text[at]), _mm_packus_epi16(first, second));
+                pos += 16;
+            }
+
+            if (pos>=length)
+                break;
+        }
+#endif
+
+        unsigned long unit = static_cast<unsigned long>(data[pos++]);
+
+        if (unit>=0xD800 && unit<=0xDBFF)
+        {
+            unsigned long next = pos<length ? static_cast<unsigned long>(data[pos]) : 0;
+            if (next>=0xDC00 && next<=0xDFFF)
+            {
+                pos++;
+                unit = 0x10000 + ((unit - 0xD800) << 10) + (next - 0xDC00);
+            } else {
+                valid = false;
+                unit = REPLACEMENT;
+            }
+        } else if ((unit>=0xDC00 && unit<=0xDFFF) || unit>0x10FFFF) {
+            valid = false;
+            unit = REPLACEMENT;
+        }
+
+        appendUtf8(text, unit);
+    }
+
+    return text;
+}
+
+string wideToUtf8(const wstring &text)
+{
+    bool valid;
+    return wideToUtf8(text.data(), text.length(), valid);
+}
+
+/* Box names, paths and ini keys all compare case insensitive */
+wstring toLower(const wstring &text)
+{
+    wstring lower(text);
+    transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
+    return lower;
+}
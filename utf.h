@@ -0,0 +1,51 @@
+#ifndef UTF_H
+#define UTF_H
+
+/**************************************************************************
+    utf.h
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Copyright © 2021 by Andreas Fischer (andreas@sociallydead.net)
+
+    File utf.h created by afischer on 18.10.2026
+**************************************************************************/
+
+/*
+ * UTF-8 <-> UTF-16 conversion. Inside the launcher everything is a wstring
+ * (UTF-16, what the W functions want), UTF-8 only exists in files and on
+ * the network. So we convert exactly once where the data comes in or goes out.
+ *
+ * Nearly everything we convert is plain ASCII (manifests, paths, box names),
+ * so 16 characters at a time are checked and widened/narrowed with SSE2 and
+ * only the rest goes through the checking byte by byte code.
+ *
+ * Invalid input (broken sequences, overlong forms, lone surrogates) becomes
+ * U+FFFD and valid is set to false.
+ *
+ * toLower is here as well, for case insensitive compares of box names,
+ * paths and ini keys.
+ */
+
+#include <string>
+
+using namespace std;
+
+wstring utf8ToWide(const char *data, size_t length, bool &valid);
+wstring utf8ToWide(const string &text);
+string wideToUtf8(const wchar_t *data, size_t length, bool &valid);
+string wideToUtf8(const wstring &text);
+wstring toLower(const wstring &text);
+
+#endif // UTF_H